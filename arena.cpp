@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <arena.h>
+#include <cstring>
+#include <cstdint>
+
+// most allocations share blocks of this size; bigger ones get their own
+static const size_t blockSize = 64 * 1024;
+
+Arena::Arena()
+    : next(nullptr)
+    , left(0)
+{}
+
+void* Arena::Allocate(size_t size, size_t align)
+{
+    size_t padding = (align - (uintptr_t)next % align) % align;
+    if(padding + size > left) {
+        if(size > blockSize / 4) {
+            // keeps the current block going for the small stuff
+            blocks.emplace_back(new char[size]);
+            return blocks.back().get();
+        }
+        blocks.emplace_back(new char[blockSize]);
+        next = blocks.back().get();
+        left = blockSize;
+        padding = 0;
+    }
+    void* rval = next + padding;
+    next += padding + size;
+    left -= padding + size;
+    return rval;
+}
+
+Text Arena::Copy(wchar_t const* s, size_t size)
+{
+    wchar_t* copy = (wchar_t*)Allocate((size + 1) * sizeof(wchar_t), alignof(wchar_t));
+    memcpy(copy, s, size * sizeof(wchar_t));
+    copy[size] = L'\0';
+    return { copy, size };
+}
+
+Text Arena::Intern(wchar_t const* s, size_t size)
+{
+    auto found = symbols.find(Text{ s, size });
+    if(found != symbols.end()) return *found;
+
+    Text rval = Copy(s, size);
+    symbols.insert(rval);
+    return rval;
+}
+
+size_t Arena::TextHash::operator()(Text const& t) const
+{
+    // FNV-1a
+    uint64_t h = 0xCBF29CE484222325ull;
+    for(wchar_t c: t) {
+        h ^= (uint64_t)c;
+        h *= 0x100000001B3ull;
+    }
+    return (size_t)h;
+}
+
+bool Arena::TextEqual::operator()(Text const& a, Text const& b) const
+{
+    return a.size == b.size && wmemcmp(a.data, b.data, a.size) == 0;
+}
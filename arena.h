@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cwchar>
+#include <string>
+#include <ostream>
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <unordered_set>
+
+// A string owned by an Arena; always null terminated.
+struct Text
+{
+    wchar_t const* data;
+    size_t size;
+
+    wchar_t const* c_str() const { return data; }
+    wchar_t const* begin() const { return data; }
+    wchar_t const* end() const { return data + size; }
+    std::wstring str() const { return std::wstring(data, size); }
+    bool operator==(wchar_t const* s) const { return wcscmp(data, s) == 0; }
+    bool operator!=(wchar_t const* s) const { return !(*this == s); }
+};
+
+inline std::wostream& operator<<(std::wostream& os, Text const& t)
+{
+    return os.write(t.data, t.size);
+}
+
+// Hands out memory from big blocks and frees all of it at once when it
+// goes away. Nothing allocated in it is ever destroyed, so it only takes
+// trivially destructible things.
+struct Arena
+{
+    Arena();
+
+    template<typename T, typename... Args>
+    T* New(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "arena objects are never destroyed");
+        return new(Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    // Returns a copy of s that lives as long as the arena.
+    Text Copy(wchar_t const* s, size_t size);
+
+    // Returns the arena's copy of s; every copy of the same string is
+    // the same one, so each distinct name is stored once.
+    Text Intern(wchar_t const* s, size_t size);
+
+private:
+    struct TextHash { size_t operator()(Text const& t) const; };
+    struct TextEqual { bool operator()(Text const& a, Text const& b) const; };
+
+    std::vector<std::unique_ptr<char[]>> blocks;
+    char* next;
+    size_t left;
+    std::unordered_set<Text, TextHash, TextEqual> symbols;
+
+    void* Allocate(size_t size, size_t align);
+
+    Arena(Arena const&) = delete;
+    Arena& operator=(Arena const&) = delete;
+};
+
+#endif
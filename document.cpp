@@ -0,0 +1,78 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <document.h>
+#include <parser_types.h>
+#include <arena.h>
+#include <mappedfile.h>
+#include <cstdlib>
+
+extern void* ParseAlloc(void* (*)(size_t));
+extern void Parse(void*, int, TokenText, ParseContext*);
+extern void ParseFree(void*, void (*)(void*));
+
+bool ParseDocument(Tokenizer& tokenizer, File& f, ParseError& error, std::function<void(Token const&)> onToken)
+{
+    // the syntax tree only lives until f is filled in
+    Arena arena;
+    ParseContext context = { &f, &arena, false, {} };
+    auto pParser = ParseAlloc(malloc);
+    try {
+        do {
+            auto t = tokenizer();
+            if(onToken) onToken(t);
+            Parse(pParser, t.type, t.text, &context);
+            if(context.failed || t.type == TEOF) break;
+        } while(1);
+        if(!context.failed) f.Finalize();
+    } catch(ParseError& e) {
+        // thrown by File::Add and File::Finalize
+        context.failed = true;
+        context.error = e;
+    } catch(...) {
+        ParseFree(pParser, free);
+        throw;
+    }
+    ParseFree(pParser, free);
+
+    if(context.failed) error = context.error;
+    return !context.failed;
+}
+
+bool ParseDocument(char const* utf8, size_t size, File& f, ParseError& error)
+{
+    Tokenizer tokenizer(utf8, size);
+    return ParseDocument(tokenizer, f, error);
+}
+
+bool ParseDocumentFile(std::wstring const& path, File& f, ParseError& error)
+{
+    MappedFile file(path);
+    if(!file.IsOpen()) {
+        error = { 0, 0, L"Can't open " + path };
+        return false;
+    }
+    return ParseDocument((char const*)file.Data(), file.Size(), f, error);
+}
@@ -0,0 +1,45 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef DOCUMENT_H
+#define DOCUMENT_H
+
+#include <string>
+#include <cstddef>
+#include <functional>
+#include <file.h>
+#include <tokenizer.h>
+
+// Reading a .drm document into a File. Nothing is shared between calls,
+// so any number of documents can be read at once, each into its own File.
+// On failure, false is returned with error filled in, and f is left with
+// whatever had been read up to that point.
+
+bool ParseDocument(char const* utf8, size_t size, File& f, ParseError& error);
+bool ParseDocumentFile(std::wstring const& path, File& f, ParseError& error);
+// onToken sees every token before the parser does
+bool ParseDocument(Tokenizer& tokenizer, File& f, ParseError& error, std::function<void(Token const&)> onToken = nullptr);
+
+#endif
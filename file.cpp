@@ -27,41 +27,94 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <parser_types.h>
 #include <errorassert.h>
 #include <string.h>
+#include <algorithm>
+#include <unordered_map>
 
-static void AddWho(File* f, Section* s)
+// Names are interned by the parser, so while the document is being read
+// the same name is always the same pointer.
+struct SameName
+{
+    size_t operator()(Text const& t) const { return std::hash<wchar_t const*>()(t.data); }
+    bool operator()(Text const& a, Text const& b) const { return a.data == b.data; }
+};
+
+// orders names the way std::wstring would
+static bool NameLess(Text const& a, Text const& b)
+{
+    int cmp = wmemcmp(a.data, b.data, std::min(a.size, b.size));
+    return cmp < 0 || (cmp == 0 && a.size < b.size);
+}
+
+template<typename T>
+using ByName = std::unordered_map<Text, T, SameName, SameName>;
+
+// A File as it's being read: everything is looked up by name, since a
+// section can refer to things which are only defined further down. The
+// names belong to the parse's Arena, which outlives Finalize.
+struct FileDraft
+{
+    struct Phrase
+    {
+        int bpm = 120;
+        ByName<std::vector<File::Beat>> beats;
+    };
+
+    ByName<File::Sample> samples;
+    ByName<Phrase> phrases;
+    std::vector<Text> output; // not interned, so only comparable by content
+};
+
+// Bad input fails the parse instead of the program, pointing at the title
+// of the section it's in.
+#define EXPECT(X, ...) do{ if(!(X)) throw ParseError{ s->line, 0, error_message(__VA_ARGS__) }; }while(0)
+
+static void AddWho(FileDraft* f, Section* s)
 {
     for(auto&& o: s->options) {
         auto& sample = f->samples[o->name];
-        ASSERT(o->value->GetType() == IValue::LIST, L"Expecting a list of parameters for sample declaration ", o->name);
+        EXPECT(o->value->GetType() == IValue::LIST, L"Expecting a list of parameters for sample declaration ", o->name);
+        // the syntax tree goes away once the file is read, so the effect
+        // is set up from it here rather than when it's first used
+        bool newEffect = false;
+        IValue* params = nullptr;
         for(auto&& o2: ((List*)o->value)->values) {
-            ASSERT(o2->GetType() == IValue::OPTION, L"Expecting key value pairs for ", o->name);
+            EXPECT(o2->GetType() == IValue::OPTION, L"Expecting key value pairs for ", o->name);
             Option* o = (Option*)o2;
-            if(o->name.compare(L"path") == 0) {
+            if(o->name == L"path") {
                 auto&& val = o->value;
-                ASSERT(val->GetType() == IValue::SCALAR, L"Expecting path to be a string");
-                sample.path = ((Scalar*)val)->value;
-            } else if(o->name.compare(L"volume") == 0) {
+                EXPECT(val->GetType() == IValue::SCALAR, L"Expecting path to be a string");
+                sample.path = ((Scalar*)val)->value.str();
+            } else if(o->name == L"volume") {
                 auto&& val = o->value;
-                ASSERT(val->GetType() == IValue::SCALAR, L"Expecting volume to be a scalar");
+                EXPECT(val->GetType() == IValue::SCALAR, L"Expecting volume to be a scalar");
                 sample.volume = wcstol(((Scalar*)val)->value.c_str(), nullptr, 10);
-            } else if(o->name.compare(L"stereo") == 0) {
+            } else if(o->name == L"voices") {
                 auto&& val = o->value;
-                ASSERT(val->GetType() == IValue::SCALAR, L"Expecting stereo to be a scalar");
-                sample.effect->name = ((Scalar*)val)->value;
-            } else if(o->name.compare(L"params") == 0) {
+                EXPECT(val->GetType() == IValue::SCALAR, L"Expecting voices to be a scalar");
+                sample.voices = wcstol(((Scalar*)val)->value.c_str(), nullptr, 10);
+                EXPECT(sample.voices >= 1 && sample.voices <= File::Sample::maxVoices, L"Expecting between 1 and ", File::Sample::maxVoices, L" voices");
+            } else if(o->name == L"stereo") {
                 auto&& val = o->value;
-                sample.effect->params.reset(val->Clone());
+                EXPECT(val->GetType() == IValue::SCALAR, L"Expecting stereo to be a scalar");
+                sample.effect->name = ((Scalar*)val)->value.str();
+                newEffect = true;
+            } else if(o->name == L"params") {
+                params = o->value;
+                newEffect = true;
             } else {
-                ASSERT(o->name == L"volume" || o->name == L"path" || o->name == L"stereo" || o->name == L"params", L"Unknown parameter ", o->name);
+                EXPECT(o->name == L"volume" || o->name == L"voices" || o->name == L"path" || o->name == L"stereo" || o->name == L"params", L"Unknown parameter ", o->name);
             }
         }
+        if(newEffect) {
+            sample.effect->instance.reset(NewStereoInstance(sample.effect->name, params));
+        }
     }
 }
 
-static void AddWhat(File* f, Section* s)
+static void AddWhat(FileDraft* f, Section* s)
 {
     for(auto&& o: s->options) {
-        if(o->name.compare(L"Output") == 0) {
+        if(o->name == L"Output") {
             IValue* v = o->value;
             switch(v->GetType()) {
                 case IValue::SCALAR:
@@ -70,30 +123,34 @@ static void AddWhat(File* f, Section* s)
                 case IValue::LIST:
                     {
                         for(auto&& o: ((List*)v)->values) {
-                            ASSERT(o->GetType() == IValue::SCALAR, L"Expecting a list of options");
+                            EXPECT(o->GetType() == IValue::SCALAR, L"Expecting a list of options");
                             f->output.push_back(((Scalar*)o)->value);
                         }
                     }
+                    break;
+                default:
+                    EXPECT(false, L"Expecting Output to be a phrase name or a list of phrase names");
+                    break;
             }
         } else {
             auto& phrase = f->phrases[o->name];
-            ASSERT(o->value->GetType() == IValue::LIST, L"Expecting a list of options for ", o->name);
-            for(auto& o2: ((List*)o->value)->values) {
-                ASSERT(o2->GetType() == IValue::OPTION, L"Expecting a list of options for ", o->name);
+            EXPECT(o->value->GetType() == IValue::LIST, L"Expecting a list of options for ", o->name);
+            for(auto&& o2: ((List*)o->value)->values) {
+                EXPECT(o2->GetType() == IValue::OPTION, L"Expecting a list of options for ", o->name);
                 auto o = (Option*)o2;
                 auto name = o->name;
-                if(name.compare(L"bpm") == 0) {
-                    ASSERT(o->value->GetType() == IValue::SCALAR, L"Expecting bpm to be a scalar");
+                if(name == L"bpm") {
+                    EXPECT(o->value->GetType() == IValue::SCALAR, L"Expecting bpm to be a scalar");
                     phrase.bpm = wcstol(((Scalar*)o->value)->value.c_str(), nullptr, 10);
                 } else {
-                    ASSERT(name == L"bpm", L"Unknown parameter ", name);
+                    EXPECT(name == L"bpm", L"Unknown parameter ", name);
                 }
             }
         }
     }
 }
 
-static void AddBeats(File* f, Section* s)
+static void AddBeats(FileDraft* f, Section* s)
 {
     auto& phrase = f->phrases[s->name];
     for(auto&& o: s->options) {
@@ -121,13 +178,13 @@ static void AddBeats(File* f, Section* s)
                 case L' ':
                     break;
                 default:
-                    ASSERT(c == L'.' || c == L'-' || c == L'/' || c == L'!' || c == L':', L"Unknown beat character ", c);
+                    EXPECT(c == L'.' || c == L'-' || c == L'/' || c == L'!' || c == L':', L"Unknown beat character ", c);
                     break;
                 }
             }
             break;
         default:
-            ASSERT("Not implemented" == NULL);
+            EXPECT(o->value->GetType() == IValue::SCALAR, L"Expecting the beats of ", o->name, L" to be a string");
             break;
         }
     }
@@ -135,8 +192,77 @@ static void AddBeats(File* f, Section* s)
 
 void File::Add(Section* s)
 {
-    if(s->name.compare(L"WHO") == 0) AddWho(this, s);
-    else if(s->name.compare(L"WHAT") == 0) AddWhat(this, s);
-    else AddBeats(this, s); 
-    delete s;
+    if(!draft) draft = std::make_shared<FileDraft>();
+    if(s->name == L"WHO") AddWho(draft.get(), s);
+    else if(s->name == L"WHAT") AddWhat(draft.get(), s);
+    else AddBeats(draft.get(), s); 
+}
+
+void File::Finalize()
+{
+    if(!draft) draft = std::make_shared<FileDraft>();
+
+    // IDs go in order of name
+    auto byName = [](ByName<Sample>::value_type const* a, ByName<Sample>::value_type const* b) -> bool {
+        return NameLess(a->first, b->first);
+    };
+    std::vector<ByName<Sample>::value_type*> sampleEntries;
+    for(auto&& entry: draft->samples) sampleEntries.push_back(&entry);
+    std::sort(sampleEntries.begin(), sampleEntries.end(), byName);
+
+    ByName<unsigned> sampleIds;
+    samples.reserve(sampleEntries.size());
+    for(auto&& entry: sampleEntries) {
+        sampleIds.emplace(entry->first, (unsigned)samples.size());
+        samples.push_back(std::move(entry->second));
+        samples.back().name = entry->first.str();
+    }
+
+    std::vector<ByName<FileDraft::Phrase>::value_type*> phraseEntries;
+    for(auto&& entry: draft->phrases) phraseEntries.push_back(&entry);
+    std::sort(phraseEntries.begin(), phraseEntries.end(), [](ByName<FileDraft::Phrase>::value_type const* a, ByName<FileDraft::Phrase>::value_type const* b) -> bool {
+                return NameLess(a->first, b->first);
+            });
+
+    phrases.reserve(phraseEntries.size());
+    for(auto&& entry: phraseEntries) {
+        phrases.emplace_back();
+        auto&& phrase = phrases.back();
+        phrase.name = entry->first.str();
+        phrase.bpm = entry->second.bpm;
+
+        // rows for samples nobody declared never play, but they still
+        // count towards the length of the phrase
+        std::vector<std::pair<unsigned, std::vector<Beat> const*>> rows;
+        for(auto&& row: entry->second.beats) {
+            phrase.length = std::max(phrase.length, row.second.size());
+            auto&& found = sampleIds.find(row.first);
+            if(found == sampleIds.end()) continue;
+            rows.emplace_back(found->second, &row.second);
+        }
+        std::sort(rows.begin(), rows.end());
+        phrase.rowWords = (phrase.length + Phrase::beatsPerWord - 1) / Phrase::beatsPerWord;
+        phrase.beats.assign(rows.size() * phrase.rowWords, 0);
+        for(size_t i = 0; i < rows.size(); ++i) {
+            phrase.samples.push_back(rows[i].first);
+            uint64_t* words = phrase.beats.data() + i * phrase.rowWords;
+            auto&& row = *rows[i].second;
+            for(size_t j = 0; j < row.size(); ++j) {
+                words[j / Phrase::beatsPerWord] |= (uint64_t)row[j] << (j % Phrase::beatsPerWord * 2);
+            }
+        }
+    }
+
+    output.reserve(draft->output.size());
+    for(auto&& name: draft->output) {
+        auto&& found = std::lower_bound(phraseEntries.begin(), phraseEntries.end(), name, [](ByName<FileDraft::Phrase>::value_type const* a, Text const& b) -> bool {
+                    return NameLess(a->first, b);
+                });
+        if(found == phraseEntries.end() || NameLess(name, (*found)->first)) {
+            throw ParseError{ 0, 0, error_message(L"Unknown phrase ", name, L" in Output") };
+        }
+        output.push_back((unsigned)(found - phraseEntries.begin()));
+    }
+
+    draft.reset();
 }
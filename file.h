@@ -32,58 +32,102 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <functional>
 #include <stereo.h>
 #include <parser_types.h>
+#include <simd.h>
 #include <cwchar>
+#include <cstdint>
+
+struct FileDraft;
 
 struct File
 {
     void Add(Section*);
+    // Resolves every name to an ID once the whole document has been read.
+    // Until then, nothing but Add may be used.
+    void Finalize();
 
     struct Sample
     {
         struct Effect {
             std::wstring name;
-            std::shared_ptr<IValue> params;
+            std::shared_ptr<StereoInstance> instance;
             std::function<stereo_sample_t(float)> apply;
-            std::function<StereoInstance*()> getInstance;
 
             Effect()
-                : params(nullptr)
-                  , name(L"")
+                : name(L"")
             {
                 this->apply = [this](float mono) -> stereo_sample_t {
-                    auto instance = std::shared_ptr<StereoInstance>(NewStereoInstance(name, params.get()));
-                    this->apply = [instance](float mono) -> stereo_sample_t {
-                        return (*instance)(mono);
-                    };
-                    return (*instance)(mono);
+                    return Instance()(mono);
                 };
             }
 
-            stereo_sample_t operator()(float mono)
+            StereoInstance& Instance()
             {
-                auto inst = getInstance();
-                return (*inst)(mono);
+                if(!instance) instance.reset(NewStereoInstance(name, nullptr));
+                return *instance;
             }
         };
 
+        // upper limit for voices
+        static const int maxVoices = 16;
+
+        std::wstring name;
         int volume;
+        int voices = 1; // how many hits can ring at the same time
         std::wstring path;
-        std::shared_ptr<Effect> effect = decltype(effect)(new Effect()); // pointer because iterating over a map copies this whole thing (for some reason)
+        std::shared_ptr<Effect> effect = decltype(effect)(new Effect()); // shared with the render plan
     };
 
-    enum class Beat {
+    // two bits each once packed, with rests as 0
+    enum class Beat : uint8_t {
         REST, HALF, FULL, STOP
     };
 
+    // Beats are packed 32 to a word, the first one in the lowest bits.
+    // Rests are all zero bits, so the hits in a row are found by scanning
+    // for set bits instead of looking at every beat.
     struct Phrase
     {
+        static const size_t beatsPerWord = 32;
+
+        std::wstring name;
         int bpm = 120;
-        std::map<std::wstring, std::vector<Beat>> beats;
+        size_t length = 0; // in beats; shorter rows are padded with rests
+        size_t rowWords = 0; // how many words each row takes
+        std::vector<unsigned> samples; // the ID of the sample each row plays, ascending
+        std::vector<uint64_t> beats; // every row back to back
+
+        uint64_t const* Row(size_t row) const { return beats.data() + row * rowWords; }
+
+        Beat At(size_t row, size_t i) const
+        {
+            return (Beat)((Row(row)[i / beatsPerWord] >> (i % beatsPerWord * 2)) & 3);
+        }
+
+        // calls f(i, beat) for every beat in row which isn't a rest, in order
+        template<typename F>
+        void ForEachHit(size_t row, F&& f) const
+        {
+            uint64_t const* words = Row(row);
+            for(size_t w = 0; w < rowWords; ++w) {
+                uint64_t word = words[w];
+                // the low bit of each beat which isn't a rest
+                uint64_t hits = (word | (word >> 1)) & 0x5555555555555555ull;
+                while(hits) {
+                    unsigned bit = CountTrailingZeros(hits);
+                    f(w * beatsPerWord + bit / 2, (Beat)((word >> bit) & 3));
+                    hits &= hits - 1;
+                }
+            }
+        }
     };
 
-    std::map<std::wstring, Sample> samples;
-    std::map<std::wstring, Phrase> phrases;
-    std::vector<std::wstring> output;
+    // IDs are indices into these, in order of name
+    std::vector<Sample> samples;
+    std::vector<Phrase> phrases;
+    std::vector<unsigned> output; // phrase IDs
+
+private:
+    std::shared_ptr<FileDraft> draft; // what's been read so far
 };
 
 #endif
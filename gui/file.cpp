@@ -24,7 +24,150 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "file.h"
+#include <algorithm>
+#include <cwctype>
 
-void File::Add(Section*)
+extern std::vector<Schema> drumSchemas;
+extern std::vector<Schema> whatSchemas;
+
+static std::wstring ScalarText(IValue* v)
+{
+    if(v->GetType() != IValue::SCALAR) return L"";
+    return ((Scalar*)v)->value.str();
+}
+
+// the drum schema whose stereo stub is effect; Mono if there's no effect
+static Schema const* FindDrumSchema(std::wstring const& effect)
+{
+    for(auto&& schema : drumSchemas) {
+        for(auto&& attr : schema.attributes) {
+            if(attr.type == Schema::STUB
+                    && attr.children.size() == 1
+                    && effect == attr.children.front().name)
+            {
+                return &schema;
+            }
+        }
+    }
+    return &drumSchemas[0];
+}
+
+static WhatEntry& FindWhat(Model& m, std::wstring const& name)
+{
+    auto found = std::find_if(m.whats.begin(), m.whats.end(), [&name](WhatEntry const& w) -> bool {
+                return w.name == name;
+            });
+    if(found != m.whats.end()) return *found;
+    m.whats.push_back({ name, L"120", &whatSchemas[0], {} });
+    return m.whats.back();
+}
+
+// params are kept flat, the way the schemas look them up
+static void AddParams(WhoEntry::Params& params, IValue* v)
+{
+    switch(v->GetType()) {
+    case IValue::SCALAR:
+        params.emplace_back(L"pan", ScalarText(v));
+        break;
+    case IValue::OPTION:
+        params.emplace_back(((Option*)v)->name.str(), ScalarText(((Option*)v)->value));
+        break;
+    case IValue::LIST:
+        for(auto&& o : ((List*)v)->values) {
+            AddParams(params, o);
+        }
+        break;
+    }
+}
+
+static void AddWho(Model& m, Section* s)
+{
+    for(auto&& o : s->options) {
+        WhoEntry who = { o->name.str(), nullptr, {} };
+        std::wstring effect;
+        if(o->value->GetType() == IValue::LIST) {
+            for(auto&& v : ((List*)o->value)->values) {
+                if(v->GetType() != IValue::OPTION) continue;
+                auto p = (Option*)v;
+                if(p->name == L"params") {
+                    AddParams(who.params, p->value);
+                } else {
+                    if(p->name == L"stereo") effect = ScalarText(p->value);
+                    who.params.emplace_back(p->name.str(), ScalarText(p->value));
+                }
+            }
+        }
+        who.schema = FindDrumSchema(effect);
+        m.whos.push_back(who);
+    }
+}
+
+static void AddWhat(Model& m, Section* s)
+{
+    for(auto&& o : s->options) {
+        if(o->name == L"Output") {
+            std::vector<std::wstring> names;
+            if(o->value->GetType() == IValue::LIST) {
+                for(auto&& v : ((List*)o->value)->values) {
+                    names.push_back(ScalarText(v));
+                }
+            } else {
+                names.push_back(ScalarText(o->value));
+            }
+            for(auto&& name : names) {
+                if(!m.output.empty()) m.output += L" ";
+                m.output += name;
+            }
+        } else {
+            auto&& what = FindWhat(m, o->name.str());
+            if(o->value->GetType() != IValue::LIST) continue;
+            for(auto&& v : ((List*)o->value)->values) {
+                if(v->GetType() == IValue::OPTION && ((Option*)v)->name == L"bpm") {
+                    what.bpm = ScalarText(((Option*)v)->value);
+                }
+            }
+        }
+    }
+}
+
+void File::Add(Section* s)
+{
+    if(!model) model = std::make_shared<Model>();
+    if(s->name == L"WHO") {
+        AddWho(*model, s);
+    } else if(s->name == L"WHAT") {
+        AddWhat(*model, s);
+    } else {
+        auto&& rows = beats[s->name.str()];
+        for(auto&& o : s->options) {
+            auto&& row = rows[o->name.str()];
+            for(wchar_t c : ScalarText(o->value)) {
+                if(!iswspace(c)) row.push_back(c);
+            }
+        }
+    }
+}
+
+// Columns hold one cell per WHO, so they can only be laid out once all of
+// them have been read.
+void File::Finalize()
 {
+    if(!model) model = std::make_shared<Model>();
+    for(auto&& entry : beats) {
+        auto&& what = FindWhat(*model, entry.first);
+        size_t width = 0;
+        for(auto&& row : entry.second) {
+            width = std::max(width, row.second.size());
+        }
+        for(size_t i = 0; i < width; ++i) {
+            Column column;
+            for(auto&& who : model->whos) {
+                auto found = entry.second.find(who.name);
+                bool has = found != entry.second.end() && i < found->second.size();
+                column.push_back(has ? found->second[i] : L'.');
+            }
+            what.columns.push_back(column);
+        }
+    }
+    beats.clear();
 }
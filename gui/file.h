@@ -3,12 +3,18 @@
 
 #include <parser_types.h>
 #include "model.h"
+#include <map>
 
 struct File
 {
     void Add(Section*);
+    void Finalize();
 
     std::shared_ptr<Model> model;
+
+private:
+    // beat strings by WHAT and WHO name, until every WHO is known
+    std::map<std::wstring, std::map<std::wstring, std::wstring>> beats;
 };
 
 #endif
@@ -27,6 +27,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "window.h"
 #include "logger.h"
 #include "string_utils.h"
+#include "file.h"
+#include "document.h"
 
 #include <FL/Fl.H>
 
@@ -90,7 +92,16 @@ std::list<Vindow*> windows;
 
 std::shared_ptr<Model> load_model(std::string path)
 {
-    return {};
+    LOGGER(l);
+    auto wpath = MB2W(path.c_str());
+    File f;
+    ParseError error;
+    if(!ParseDocumentFile(wpath, f, error)) {
+        l(L"Failed to load %ls: %ls at line %d, column %d", wpath.c_str(), error.message.c_str(), error.line, error.column);
+        return {};
+    }
+    f.model->path = wpath;
+    return f.model;
 }
 
 bool is_any_model_dirty()
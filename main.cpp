@@ -36,14 +36,17 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <errorassert.h>
 
 #include <file.h>
+#include <document.h>
 #include <parser.h>
 #include <parser_types.h>
 #include <string_utils.h>
 #include <version.h>
+#include <render.h>
+#include <parallel.h>
 
 void help(std::wstring argv0)
 {
-    wprintf(L"usage: %ls [-v|-w fileName|-W fileNamePattern]\n", argv0.c_str());
+    wprintf(L"usage: %ls [-v] [-s] [-j jobs] [-c exact|rational|table] [-q fast|medium|best] [-k cacheDir] [-f u8|s16|s24|s32|f32|f64 [-d]] [-w fileName|-W fileNamePattern|-p [-b bufferFrames]]\n", argv0.c_str());
     exit(2);
 }
 
@@ -56,8 +59,13 @@ int main(int argc, char* argv[])
 #ifdef __GNUC__
     setlocale(LC_CTYPE, "C.UTF-8");
 #endif
-    std::wstring fileName = L"test.wav";
-    bool split = false;
+    RenderOptions options;
+    options.jobs = DefaultJobs();
+#ifdef _MSC_VER
+    if(_wgetenv(L"JAKBEAT_CACHE")) options.cacheDir = _wgetenv(L"JAKBEAT_CACHE");
+#else
+    if(getenv("JAKBEAT_CACHE")) options.cacheDir = MB2W(getenv("JAKBEAT_CACHE"));
+#endif
     for(int i = 1; i < argc; ++i) {
 #ifdef _MSC_VER
         if(wcscmp(argv[i], L"-v") == 0) {
@@ -74,9 +82,9 @@ int main(int argc, char* argv[])
             ++i;
             ASSERT(i < argc);
 #ifdef _MSC_VER
-            fileName.assign(argv[i]);
+            options.filename.assign(argv[i]);
 #else
-            fileName = MB2W(argv[i]);
+            options.filename = MB2W(argv[i]);
 #endif
 #ifdef _MSC_VER
         } else if(wcscmp(argv[i], L"-W") == 0) {
@@ -85,12 +93,109 @@ int main(int argc, char* argv[])
 #endif
             ++i;
             ASSERT(i < argc);
-            split = true;
+            options.split = true;
+#ifdef _MSC_VER
+            options.filename.assign(argv[i]);
+#else
+            options.filename = MB2W(argv[i]);
+#endif
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-s") == 0) {
+#else
+        } else if(strcmp(argv[i], "-s") == 0) {
+#endif
+            options.stats = true;
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-p") == 0) {
+#else
+        } else if(strcmp(argv[i], "-p") == 0) {
+#endif
+            options.play = true;
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-b") == 0) {
+#else
+        } else if(strcmp(argv[i], "-b") == 0) {
+#endif
+            ++i;
+            ASSERT(i < argc);
+#ifdef _MSC_VER
+            long frames = wcstol(argv[i], nullptr, 10);
+#else
+            long frames = strtol(argv[i], nullptr, 10);
+#endif
+            ASSERT(frames > 0, L"Expecting a positive buffer size");
+            options.bufferFrames = (size_t)frames;
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-j") == 0) {
+#else
+        } else if(strcmp(argv[i], "-j") == 0) {
+#endif
+            ++i;
+            ASSERT(i < argc);
+#ifdef _MSC_VER
+            long jobs = wcstol(argv[i], nullptr, 10);
+#else
+            long jobs = strtol(argv[i], nullptr, 10);
+#endif
+            ASSERT(jobs > 0, L"Expecting a positive number of jobs");
+            options.jobs = (unsigned)jobs;
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-c") == 0) {
+#else
+        } else if(strcmp(argv[i], "-c") == 0) {
+#endif
+            ++i;
+            ASSERT(i < argc);
+#ifdef _MSC_VER
+            std::wstring clip = argv[i];
+#else
+            std::wstring clip = MB2W(argv[i]);
+#endif
+            ASSERT(ParseSoftClip(clip, options.softClip), L"Unknown soft clipper ", clip, L"; expecting exact, rational or table");
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-k") == 0) {
+#else
+        } else if(strcmp(argv[i], "-k") == 0) {
+#endif
+            ++i;
+            ASSERT(i < argc);
+#ifdef _MSC_VER
+            options.cacheDir.assign(argv[i]);
+#else
+            options.cacheDir = MB2W(argv[i]);
+#endif
 #ifdef _MSC_VER
-            fileName.assign(argv[i]);
+        } else if(wcscmp(argv[i], L"-q") == 0) {
 #else
-            fileName = MB2W(argv[i]);
+        } else if(strcmp(argv[i], "-q") == 0) {
 #endif
+            ++i;
+            ASSERT(i < argc);
+#ifdef _MSC_VER
+            std::wstring quality = argv[i];
+#else
+            std::wstring quality = MB2W(argv[i]);
+#endif
+            ASSERT(ParseResampleQuality(quality, options.resampleQuality), L"Unknown resampler quality ", quality, L"; expecting fast, medium or best");
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-f") == 0) {
+#else
+        } else if(strcmp(argv[i], "-f") == 0) {
+#endif
+            ++i;
+            ASSERT(i < argc);
+#ifdef _MSC_VER
+            std::wstring format = argv[i];
+#else
+            std::wstring format = MB2W(argv[i]);
+#endif
+            ASSERT(ParsePcmFormat(format, options.format), L"Unknown sample format ", format, L"; expecting u8, s16, s24, s32, f32 or f64");
+#ifdef _MSC_VER
+        } else if(wcscmp(argv[i], L"-d") == 0) {
+#else
+        } else if(strcmp(argv[i], "-d") == 0) {
+#endif
+            options.dither = true;
         } else {
             std::wstring argv0 =
 #ifdef _MSC_VER
@@ -102,25 +207,22 @@ int main(int argc, char* argv[])
         }
     }
 
-    extern void* ParseAlloc(void* (*)(size_t));
-    extern void Parse(void*, int, wchar_t*, File*);
-    extern void ParseFree(void*, void (*)(void*));
-    extern void Render(File, std::wstring, bool);
-
     File f;
-    reopen_read_unicode(stdin);
+    ParseError error;
     Tokenizer tok(stdin);
-    auto pParser = ParseAlloc(malloc);
-    do {
-        auto t = tok();
-        wprintf(L"%d %ls\n", t.type, (t.type == STRING) ? t.value.c_str() : L"");
-        wchar_t* s = wcsdup(t.value.c_str());
-        Parse(pParser, t.type, s, &f);
-        if(t.type == TEOF) break;
-    } while(1);
-    ParseFree(pParser, free);
+    bool parsed = ParseDocument(tok, f, error, [&options](Token const& t) {
+                // stdout may be where the song goes
+                if(options.filename != L"-") wprintf(L"%d %ls\n", t.type, (t.type == STRING) ? t.text.str().c_str() : L"");
+            });
+    if(!parsed) {
+        if(error.column) fwprintf(stderr, L"%ls at line %d, column %d\n", error.message.c_str(), error.line, error.column);
+        else if(error.line) fwprintf(stderr, L"%ls in the section at line %d\n", error.message.c_str(), error.line);
+        else fwprintf(stderr, L"%ls\n", error.message.c_str());
+        exit(2);
+    }
+    fwprintf(stderr, L"Successfully parsed file.\n");
 
-    Render(f, fileName, split);
+    Render(f, options);
 
     return 0;
 }
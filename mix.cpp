@@ -0,0 +1,265 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <mix.h>
+#include <simd.h>
+#include <algorithm>
+
+// The sums are soft-clipped this many frames at a time, while they're
+// still in L1.
+static const size_t chunkFrames = 64;
+
+// sums frames [from + i, from + n) of each track into sumLeft and sumRight
+static void SumScalar(float const* const* left, float const* const* right, size_t numTracks, size_t from, float* sumLeft, float* sumRight, size_t i, size_t n)
+{
+    for(; i < n; ++i) {
+        float l = 0.f, r = 0.f;
+        for(size_t t = 0; t < numTracks; ++t) {
+            l += left[t][from + i];
+            r += right[t][from + i];
+        }
+        sumLeft[i] = l;
+        sumRight[i] = r;
+    }
+}
+
+static void InterleaveScalar(float const* left, float const* right, float* out, size_t i, size_t n)
+{
+    for(; i < n; ++i) {
+        out[2 * i + 0] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+static void VoiceScalar(float const* const* voices, float const* gains, size_t numVoices, float volume, float* out, size_t i, size_t n)
+{
+    for(; i < n; ++i) {
+        float sum = gains[0] * voices[0][i] * volume;
+        for(size_t v = 1; v < numVoices; ++v) {
+            sum += gains[v] * voices[v][i] * volume;
+        }
+        out[i] = sum;
+    }
+}
+
+SIMD_TARGET_SSE41
+static void SumSse41(float const* const* left, float const* const* right, size_t numTracks, size_t from, float* sumLeft, float* sumRight, size_t n)
+{
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 l = _mm_setzero_ps();
+        __m128 r = _mm_setzero_ps();
+        for(size_t t = 0; t < numTracks; ++t) {
+            l = _mm_add_ps(l, _mm_loadu_ps(left[t] + from + i));
+            r = _mm_add_ps(r, _mm_loadu_ps(right[t] + from + i));
+        }
+        _mm_storeu_ps(sumLeft + i, l);
+        _mm_storeu_ps(sumRight + i, r);
+    }
+    SumScalar(left, right, numTracks, from, sumLeft, sumRight, i, n);
+}
+
+SIMD_TARGET_SSE41
+static void InterleaveSse41(float const* left, float const* right, float* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i);
+        __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(out + 2 * i + 0, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    InterleaveScalar(left, right, out, i, n);
+}
+
+SIMD_TARGET_SSE41
+static void VoiceSse41(float const* const* voices, float const* gains, size_t numVoices, float volume, float* out, size_t n)
+{
+    __m128 vol = _mm_set1_ps(volume);
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 sum = _mm_mul_ps(_mm_mul_ps(_mm_set1_ps(gains[0]), _mm_loadu_ps(voices[0] + i)), vol);
+        for(size_t v = 1; v < numVoices; ++v) {
+            __m128 x = _mm_mul_ps(_mm_set1_ps(gains[v]), _mm_loadu_ps(voices[v] + i));
+            sum = _mm_add_ps(sum, _mm_mul_ps(x, vol));
+        }
+        _mm_storeu_ps(out + i, sum);
+    }
+    VoiceScalar(voices, gains, numVoices, volume, out, i, n);
+}
+
+SIMD_TARGET_AVX2
+static void SumAvx2(float const* const* left, float const* const* right, size_t numTracks, size_t from, float* sumLeft, float* sumRight, size_t n)
+{
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 l = _mm256_setzero_ps();
+        __m256 r = _mm256_setzero_ps();
+        for(size_t t = 0; t < numTracks; ++t) {
+            l = _mm256_add_ps(l, _mm256_loadu_ps(left[t] + from + i));
+            r = _mm256_add_ps(r, _mm256_loadu_ps(right[t] + from + i));
+        }
+        _mm256_storeu_ps(sumLeft + i, l);
+        _mm256_storeu_ps(sumRight + i, r);
+    }
+    SumScalar(left, right, numTracks, from, sumLeft, sumRight, i, n);
+}
+
+SIMD_TARGET_AVX2
+static void InterleaveAvx2(float const* left, float const* right, float* out, size_t n)
+{
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 l = _mm256_loadu_ps(left + i);
+        __m256 r = _mm256_loadu_ps(right + i);
+        // unpack works within 128bit lanes, so the halves need to be put
+        // back in order
+        __m256 lo = _mm256_unpacklo_ps(l, r);
+        __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(out + 2 * i + 0, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    InterleaveScalar(left, right, out, i, n);
+}
+
+SIMD_TARGET_AVX2
+static void VoiceAvx2(float const* const* voices, float const* gains, size_t numVoices, float volume, float* out, size_t n)
+{
+    __m256 vol = _mm256_set1_ps(volume);
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 sum = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(gains[0]), _mm256_loadu_ps(voices[0] + i)), vol);
+        for(size_t v = 1; v < numVoices; ++v) {
+            __m256 x = _mm256_mul_ps(_mm256_set1_ps(gains[v]), _mm256_loadu_ps(voices[v] + i));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(x, vol));
+        }
+        _mm256_storeu_ps(out + i, sum);
+    }
+    VoiceScalar(voices, gains, numVoices, volume, out, i, n);
+}
+
+static const bool hasAvx2 = CpuHasAvx2();
+static const bool hasSse41 = CpuHasSse41();
+
+static void Sum(float const* const* left, float const* const* right, size_t numTracks, size_t from, float* sumLeft, float* sumRight, size_t n)
+{
+    if(hasAvx2) SumAvx2(left, right, numTracks, from, sumLeft, sumRight, n);
+    else if(hasSse41) SumSse41(left, right, numTracks, from, sumLeft, sumRight, n);
+    else SumScalar(left, right, numTracks, from, sumLeft, sumRight, 0, n);
+}
+
+static void Interleave(float const* left, float const* right, float* out, size_t n)
+{
+    if(hasAvx2) InterleaveAvx2(left, right, out, n);
+    else if(hasSse41) InterleaveSse41(left, right, out, n);
+    else InterleaveScalar(left, right, out, 0, n);
+}
+
+void MixBlock(float const* const* left, float const* const* right, size_t numTracks, float* out, size_t n, SoftClip clip)
+{
+    // left and right sums of a chunk, back to back, so they can be
+    // clipped in one go
+    alignas(32) float sum[2 * chunkFrames];
+
+    for(size_t i = 0; i < n; i += chunkFrames) {
+        size_t m = std::min(chunkFrames, n - i);
+        Sum(left, right, numTracks, i, sum, sum + chunkFrames, m);
+        SoftClipBlock(clip, sum, m);
+        SoftClipBlock(clip, sum + chunkFrames, m);
+        Interleave(sum, sum + chunkFrames, out + 2 * i, m);
+    }
+}
+
+void VoiceBlock(float const* const* voices, float const* gains, size_t numVoices, float volume, float* out, size_t n)
+{
+    if(hasAvx2) VoiceAvx2(voices, gains, numVoices, volume, out, n);
+    else if(hasSse41) VoiceSse41(voices, gains, numVoices, volume, out, n);
+    else VoiceScalar(voices, gains, numVoices, volume, out, 0, n);
+}
+
+void ClipBlock(float const* left, float const* right, float* out, size_t n, SoftClip clip)
+{
+    alignas(32) float buf[2 * chunkFrames];
+
+    for(size_t i = 0; i < n; i += chunkFrames) {
+        size_t m = std::min(chunkFrames, n - i);
+        std::copy(left + i, left + i + m, buf);
+        std::copy(right + i, right + i + m, buf + chunkFrames);
+        SoftClipBlock(clip, buf, m);
+        SoftClipBlock(clip, buf + chunkFrames, m);
+        Interleave(buf, buf + chunkFrames, out + 2 * i, m);
+    }
+}
+
+#ifdef BENCH_MIX
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include <functional>
+int main()
+{
+    // 40 tracks, mixed 256 frames at a time, like the renderer does
+    const size_t numTracks = 40, n = 256, rounds = 4000;
+    std::vector<std::vector<float>> data(2 * numTracks, std::vector<float>(n));
+    for(auto&& v: data) for(auto&& f: v) f = (rand() / (float)RAND_MAX - 0.5f) * 0.2f;
+    std::vector<float const*> left, right;
+    for(size_t t = 0; t < numTracks; ++t) {
+        left.push_back(data[2 * t].data());
+        right.push_back(data[2 * t + 1].data());
+    }
+    std::vector<float> reference(2 * n), out(2 * n);
+
+    auto bench = [&](char const* name, std::function<void()> fn) {
+        auto start = std::chrono::steady_clock::now();
+        for(size_t r = 0; r < rounds; ++r) fn();
+        auto end = std::chrono::steady_clock::now();
+        float maxDiff = 0.f;
+        for(size_t i = 0; i < 2 * n; ++i) maxDiff = fmaxf(maxDiff, fabsf(out[i] - reference[i]));
+        printf("%-10s %8.1f ns/frame, max diff %g\n", name,
+                std::chrono::duration<double, std::nano>(end - start).count() / (rounds * n),
+                maxDiff);
+    };
+
+    // what RenderNew used to do: sum each track in turn, then clip and interleave
+    auto naive = [&]() {
+        std::vector<float> l(n, 0.f), r(n, 0.f);
+        for(size_t t = 0; t < numTracks; ++t) for(size_t i = 0; i < n; ++i) l[i] += left[t][i];
+        for(size_t t = 0; t < numTracks; ++t) for(size_t i = 0; i < n; ++i) r[i] += right[t][i];
+        std::vector<float> o;
+        for(size_t i = 0; i < n; ++i) { o.push_back(tanhf(l[i])); o.push_back(tanhf(r[i])); }
+        out = o;
+    };
+    naive();
+    reference = out;
+
+    printf("%s\n", hasAvx2 ? "avx2" : hasSse41 ? "sse4.1" : "scalar");
+    bench("naive", naive);
+    bench("exact", [&]() { MixBlock(left.data(), right.data(), numTracks, out.data(), n, SoftClip::EXACT); });
+    bench("rational", [&]() { MixBlock(left.data(), right.data(), numTracks, out.data(), n, SoftClip::RATIONAL); });
+    bench("table", [&]() { MixBlock(left.data(), right.data(), numTracks, out.data(), n, SoftClip::TABLE); });
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef MIX_H
+#define MIX_H
+
+#include <cstddef>
+#include <softclip.h>
+
+// Sums n frames of numTracks planar stereo tracks, soft-clips the sum and
+// writes it to out as n interleaved stereo frames, all in one pass. The
+// tracks are summed in order starting from 0, exactly like the scalar
+// loop would, so the only difference from the scalar path is the error
+// of the chosen soft clipper (see softclip.h); with SoftClip::EXACT the
+// output is the same down to the last bit.
+void MixBlock(float const* const* left, float const* const* right, size_t numTracks, float* out, size_t n, SoftClip clip);
+
+// Same as MixBlock for a single track, without summing it with anything.
+void ClipBlock(float const* left, float const* right, float* out, size_t n, SoftClip clip);
+
+// Sums n samples of numVoices (at least one) mono voices into out, each
+// scaled by its gain and then by volume. The first voice is stored as is
+// and the rest are added in order, so a single voice comes out exactly
+// as gain * sample * volume.
+void VoiceBlock(float const* const* voices, float const* gains, size_t numVoices, float volume, float* out, size_t n);
+
+#endif
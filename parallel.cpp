@@ -0,0 +1,93 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <parallel.h>
+#include <thread>
+
+unsigned DefaultJobs()
+{
+    unsigned rval = std::thread::hardware_concurrency();
+    return (rval > 0) ? rval : 1;
+}
+
+ThreadPool::ThreadPool(unsigned threads)
+    : next(0)
+{
+    for(unsigned i = 1; i < threads; ++i) {
+        workers.emplace_back(&ThreadPool::Work, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = true;
+    }
+    wake.notify_all();
+    for(auto&& t: workers) t.join();
+}
+
+void ThreadPool::Run()
+{
+    for(size_t i = next++; i < n; i = next++) (*job)(i);
+}
+
+void ThreadPool::Work()
+{
+    unsigned seen = 0;
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true) {
+        wake.wait(lock, [&]() { return quit || generation != seen; });
+        if(quit) return;
+        seen = generation;
+        lock.unlock();
+        Run();
+        lock.lock();
+        if(--busy == 0) done.notify_one();
+    }
+}
+
+void ParallelFor(ThreadPool& pool, size_t n, std::function<void(size_t)> const& job)
+{
+    if(pool.workers.empty() || n <= 1) {
+        for(size_t i = 0; i < n; ++i) job(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.job = &job;
+        pool.n = n;
+        pool.next = 0;
+        pool.busy = (unsigned)pool.workers.size();
+        ++pool.generation;
+    }
+    pool.wake.notify_all();
+    pool.Run();
+
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    pool.done.wait(lock, [&]() { return pool.busy == 0; });
+}
@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+// number of worker threads to use when the user didn't ask for any
+unsigned DefaultJobs();
+
+// `threads' - 1 worker threads which sleep between ParallelFor calls;
+// the thread calling ParallelFor makes up the last one.
+struct ThreadPool
+{
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    unsigned Threads() const { return (unsigned)workers.size() + 1; }
+
+private:
+    friend void ParallelFor(ThreadPool& pool, size_t n, std::function<void(size_t)> const& job);
+    void Work();
+    void Run();
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake; // a new batch of jobs, or shutting down
+    std::condition_variable done; // the last worker left the batch
+    std::function<void(size_t)> const* job = nullptr;
+    size_t n = 0;
+    std::atomic<size_t> next;
+    unsigned generation = 0; // of the batch being handed out
+    unsigned busy = 0; // workers still in the batch
+    bool quit = false;
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+};
+
+// Calls job(0) .. job(n - 1) from the threads of the pool (the calling
+// thread being one of them) and returns once all of them have finished.
+// Jobs are handed out in increasing order, but may complete in any order.
+void ParallelFor(ThreadPool& pool, size_t n, std::function<void(size_t)> const& job);
+
+#endif
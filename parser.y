@@ -29,24 +29,29 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
     #include <stdlib.h>
     #include <stdio.h>
     #include <errorassert.h>
-    extern int tokenizer_lineno;
+    #include <tokenizer.h>
 
     #define assert(X) ASSERT(X)
 }
 
-%parse_accept {
-    fwprintf(stderr, L"Successfully parsed file.\n");
-}
 %parse_failure {
-    fwprintf(stderr, L"Parse failure, last line read: %d\n", tokenizer_lineno);
+    if(!Context->failed) {
+        Context->failed = true;
+        Context->error = { 0, 0, L"Parse failure" };
+    }
 }
 %syntax_error {
-    fwprintf(stderr, L"Syntax error somewhere, last line read: %d\n", tokenizer_lineno);
-    exit(2);
+    // only the first one is interesting, the rest follow from it
+    if(!Context->failed) {
+        Context->failed = true;
+        Context->error = { TOKEN.line, TOKEN.column, (yymajor != TEOF)
+            ? L"Syntax error near '" + TOKEN.str() + L"'"
+            : std::wstring(L"Syntax error at end of file") };
+    }
 }
 
-%extra_argument { File* FileHead }
-%token_type { wchar_t* }
+%extra_argument { ParseContext* Context }
+%token_type { TokenText }
 
 %type items { List* }
 %type item { IValue* }
@@ -54,7 +59,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 %type option { Option* }
 %type options { Section* }
 %type section { Section* }
-%type title { wchar_t* }
+%type title { TokenText }
 
 %start_symbol file
 
@@ -63,36 +68,37 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 file ::= sections.
 sections ::= .
 sections ::= sections section(S). {
-    FileHead->Add(S);
+    Context->file->Add(S);
 }
 section(S) ::= title(T) options(S1). {
-    S1->SetName(T);
+    S1->name = Context->arena->Intern(T.data, T.size);
+    S1->line = T.line;
     S = S1;
 }
 title(T) ::= LSQUARE STRING(S) RSQUARE. {
     T = S;
 }
 options(S) ::= . {
-    S = new Section;
+    S = Context->arena->New<Section>();
 }
 options(S) ::= options(S1) option(O). {
     S1->options.push_back(O);
     S = S1;
 }
 option(O) ::= STRING(S) EQUALS value(V). {
-    O = new Option(S, V);
+    O = Context->arena->New<Option>(Context->arena->Intern(S.data, S.size), V);
 }
 value(V) ::= STRING(S). {
-    V = new Scalar(S);
+    V = Context->arena->New<Scalar>(Context->arena->Copy(S.data, S.size));
 }
 value(V) ::= LPAREN items(I) RPAREN. {
     V = I;
 }
 items(I) ::= . {
-    I = new List();
+    I = Context->arena->New<List>();
 }
 items(I) ::= items(I1) STRING(S). {
-    I1->values.push_back(new Scalar(S));
+    I1->values.push_back(Context->arena->New<Scalar>(Context->arena->Copy(S.data, S.size)));
     I = I1;
 }
 items(I) ::= items(I1) option(O). {
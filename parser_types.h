@@ -32,90 +32,102 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <functional>
 #include <stereo.h>
 #include <string_utils.h>
+#include <arena.h>
+
+// The syntax tree. Every node and string lives in the Arena of the parse
+// which made it, and goes away with it in one go.
 
 struct IValue
 {
     typedef enum {
         SCALAR, LIST, OPTION
     } Type;
-    virtual IValue* Clone() = 0;
-    virtual Type GetType() const = 0;
-    virtual ~IValue() {}
+    Type GetType() const { return type; }
+    IValue* next; // the next value in the same List
+
+protected:
+    IValue(Type type_) : next(nullptr), type(type_) {}
+
+private:
+    Type type;
 };
 
-struct List : IValue
+// a list of nodes linked through IValue::next
+template<typename T>
+struct Chain
 {
-    IValue* Clone() override
+    struct iterator
     {
-        List* clone = new List();
-        for(auto&& v: values) {
-            clone->values.push_back(v->Clone());
-        }
-        return clone;
-    }
+        T* p;
+        T* operator*() const { return p; }
+        iterator& operator++() { p = static_cast<T*>(p->next); return *this; }
+        bool operator!=(iterator const& other) const { return p != other.p; }
+    };
 
-    IValue::Type GetType() const override { return IValue::LIST; }
-    std::vector<IValue*> values;
+    T* first = nullptr;
+    T* last = nullptr;
 
-    virtual ~List()
+    void push_back(T* v)
     {
-        for(auto&& v : values) delete v;
+        if(last) last->next = v;
+        else first = v;
+        last = v;
     }
+    iterator begin() const { return { first }; }
+    iterator end() const { return { nullptr }; }
+};
+
+struct List : IValue
+{
+    Chain<IValue> values;
+
+    List() : IValue(IValue::LIST) {}
 };
 
 struct Scalar : IValue
 {
-    IValue* Clone() override { return new Scalar(value.c_str()); }
-    IValue::Type GetType() const override { return IValue::SCALAR; }
-    std::wstring value;
-    Scalar(wchar_t* s)
-    {
-        value.assign(s);
-        free(s);
-    }
-    Scalar(wchar_t const* s) { value.assign(s); }
+    Text value;
+
+    Scalar(Text value_) : IValue(IValue::SCALAR), value(value_) {}
 };
 
 struct Option : IValue
 {
-    IValue* Clone() override { return new Option(name.c_str(), value->Clone()); }
-    IValue::Type GetType() const override { return IValue::OPTION; }
-    std::wstring name;
+    Text name;
     IValue* value;
-    Option(wchar_t* name_, IValue* value_)
-    {
-        name.assign(name_);
-        free(name_);
-        value = value_;
-    }
-    Option(wchar_t const* name_, IValue* value_)
-    {
-        name.assign(name_);
-        value = value_;
-    }
-    virtual ~Option()
-    {
-        delete value;
-    }
+
+    Option(Text name_, IValue* value_)
+        : IValue(IValue::OPTION)
+        , name(name_)
+        , value(value_)
+    {}
 };
 
 struct Section
 {
-    std::wstring name;
-    std::vector<Option*> options;
+    Text name;
+    int line; // where the title is
+    Chain<Option> options;
+};
 
-    void SetName(wchar_t* s)
-    {
-        name.assign(s);
-        free(s);
-    }
+struct File;
 
-    ~Section()
-    {
-        for(auto&& o : options) {
-            delete o;
-        }
-    }
+// Why a document couldn't be read, and where; counting from 1, or 0 if
+// it's not about any one place.
+struct ParseError
+{
+    int line;
+    int column;
+    std::wstring message;
+};
+
+// what the grammar's actions build into
+struct ParseContext
+{
+    File* file;
+    Arena* arena;
+    bool failed;
+    ParseError error;
 };
 
 #endif
@@ -0,0 +1,655 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pcm.h>
+#include <simd.h>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// what the largest positive value of each integer format is scaled to 1 by
+static const float u8Scale = 127.f;
+static const float s16Scale = 32767.f;
+static const float s24Scale = 8388607.f;
+static const double s32Scale = 2147483647.0;
+
+size_t PcmSampleSize(PcmFormat format)
+{
+    switch(format) {
+    case PcmFormat::U8: return 1;
+    case PcmFormat::S16: return 2;
+    case PcmFormat::S24: return 3;
+    case PcmFormat::S32: return 4;
+    case PcmFormat::F32: return 4;
+    case PcmFormat::F64: return 8;
+    }
+    return 0;
+}
+
+bool ParsePcmFormat(std::wstring const& name, PcmFormat& format)
+{
+    if(name == L"u8") format = PcmFormat::U8;
+    else if(name == L"s16") format = PcmFormat::S16;
+    else if(name == L"s24") format = PcmFormat::S24;
+    else if(name == L"s32") format = PcmFormat::S32;
+    else if(name == L"f32") format = PcmFormat::F32;
+    else if(name == L"f64") format = PcmFormat::F64;
+    else return false;
+    return true;
+}
+
+// Clips the same way minps/maxps do, NaNs included, so every path gives
+// the same result.
+static float Clip(float x)
+{
+    x = (x < 1.f) ? x : 1.f;
+    x = (x > -1.f) ? x : -1.f;
+    return x;
+}
+
+/* scalar ***************************************************************/
+
+static void ToFloatScalar(PcmFormat format, uint8_t const* in, float* out, size_t i, size_t n)
+{
+    switch(format) {
+    case PcmFormat::U8:
+        for(; i < n; ++i) out[i] = (float)((int)in[i] - 128) / u8Scale;
+        break;
+    case PcmFormat::S16:
+        for(; i < n; ++i) {
+            int16_t x;
+            memcpy(&x, in + 2 * i, 2);
+            out[i] = (float)x / s16Scale;
+        }
+        break;
+    case PcmFormat::S24:
+        for(; i < n; ++i) {
+            uint8_t const* p = in + 3 * i;
+            int32_t x = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24)) >> 8;
+            out[i] = (float)x / s24Scale;
+        }
+        break;
+    case PcmFormat::S32:
+        for(; i < n; ++i) {
+            int32_t x;
+            memcpy(&x, in + 4 * i, 4);
+            out[i] = (float)x / (float)s32Scale;
+        }
+        break;
+    case PcmFormat::F32:
+        memcpy(out + i, in + 4 * i, (n - i) * 4);
+        break;
+    case PcmFormat::F64:
+        for(; i < n; ++i) {
+            double x;
+            memcpy(&x, in + 8 * i, 8);
+            out[i] = (float)x;
+        }
+        break;
+    }
+}
+
+static uint32_t Xorshift(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// top 24 bits as a float in [0, 1)
+static float Uniform(uint32_t x)
+{
+    return (float)(x >> 8) * (1.f / 16777216.f);
+}
+
+// Advances each generator twice and leaves the difference, triangular
+// noise in (-1, 1) LSB, in noise. The SIMD code computes the same thing
+// for all eight lanes at once.
+static void NoiseScalar(uint32_t* state, float* noise)
+{
+    for(size_t k = 0; k < PcmDither::lanes; ++k) {
+        uint32_t a = Xorshift(state[k]);
+        uint32_t b = Xorshift(a);
+        state[k] = b;
+        noise[k] = Uniform(a) - Uniform(b);
+    }
+}
+
+// i is a multiple of PcmDither::lanes, so each group of samples gets the
+// same noise whichever code path converts it
+static void FromFloatScalar(PcmFormat format, float const* in, uint8_t* out, size_t i, size_t n, uint32_t* dither)
+{
+    float noise[PcmDither::lanes] = {};
+    switch(format) {
+    case PcmFormat::U8:
+        for(; i < n; ++i) {
+            if(dither && i % PcmDither::lanes == 0) NoiseScalar(dither, noise);
+            long x = lrintf(Clip(in[i]) * u8Scale + noise[i % PcmDither::lanes]) + 128;
+            out[i] = (uint8_t)std::min(std::max(x, 0l), 255l);
+        }
+        break;
+    case PcmFormat::S16:
+        for(; i < n; ++i) {
+            if(dither && i % PcmDither::lanes == 0) NoiseScalar(dither, noise);
+            long l = lrintf(Clip(in[i]) * s16Scale + noise[i % PcmDither::lanes]);
+            int16_t x = (int16_t)std::min(std::max(l, -32768l), 32767l);
+            memcpy(out + 2 * i, &x, 2);
+        }
+        break;
+    case PcmFormat::S24:
+        for(; i < n; ++i) {
+            if(dither && i % PcmDither::lanes == 0) NoiseScalar(dither, noise);
+            long l = lrintf(Clip(in[i]) * s24Scale + noise[i % PcmDither::lanes]);
+            int32_t x = (int32_t)std::min(std::max(l, -8388608l), 8388607l);
+            out[3 * i + 0] = (uint8_t)x;
+            out[3 * i + 1] = (uint8_t)(x >> 8);
+            out[3 * i + 2] = (uint8_t)(x >> 16);
+        }
+        break;
+    case PcmFormat::S32:
+        for(; i < n; ++i) {
+            // a float can't hold 2^31 - 1, so this goes through double
+            int32_t x = (int32_t)lrint((double)Clip(in[i]) * s32Scale);
+            memcpy(out + 4 * i, &x, 4);
+        }
+        break;
+    case PcmFormat::F32:
+        memcpy(out + 4 * i, in + i, (n - i) * 4);
+        break;
+    case PcmFormat::F64:
+        for(; i < n; ++i) {
+            double x = in[i];
+            memcpy(out + 8 * i, &x, 8);
+        }
+        break;
+    }
+}
+
+/* SSE4.1 ***************************************************************/
+
+SIMD_TARGET_SSE41
+static void ToFloatSse41(PcmFormat format, uint8_t const* in, float* out, size_t n)
+{
+    size_t i = 0;
+    switch(format) {
+    case PcmFormat::U8:
+        {
+            __m128i bias = _mm_set1_epi32(128);
+            __m128 scale = _mm_set1_ps(u8Scale);
+            for(; i + 4 <= n; i += 4) {
+                int32_t bytes;
+                memcpy(&bytes, in + i, 4);
+                __m128i x = _mm_sub_epi32(_mm_cvtepu8_epi32(_mm_cvtsi32_si128(bytes)), bias);
+                _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::S16:
+        {
+            __m128 scale = _mm_set1_ps(s16Scale);
+            for(; i + 4 <= n; i += 4) {
+                __m128i x = _mm_cvtepi16_epi32(_mm_loadl_epi64((__m128i const*)(in + 2 * i)));
+                _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::S24:
+        {
+            // each sample goes to the top three bytes of a lane, and is
+            // then shifted back down with its sign
+            __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            __m128 scale = _mm_set1_ps(s24Scale);
+            // 16 bytes are read for every 12 used
+            for(; 3 * i + 16 <= 3 * n; i += 4) {
+                __m128i bytes = _mm_loadu_si128((__m128i const*)(in + 3 * i));
+                __m128i x = _mm_srai_epi32(_mm_shuffle_epi8(bytes, shuffle), 8);
+                _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::S32:
+        {
+            __m128 scale = _mm_set1_ps((float)s32Scale);
+            for(; i + 4 <= n; i += 4) {
+                __m128i x = _mm_loadu_si128((__m128i const*)(in + 4 * i));
+                _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::F32:
+        break;
+    case PcmFormat::F64:
+        for(; i + 4 <= n; i += 4) {
+            __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd((double const*)(in + 8 * i)));
+            __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd((double const*)(in + 8 * i + 16)));
+            _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+        }
+        break;
+    }
+    ToFloatScalar(format, in, out, i, n);
+}
+
+SIMD_TARGET_SSE41
+static __m128 ClipSse41(__m128 x)
+{
+    return _mm_max_ps(_mm_min_ps(x, _mm_set1_ps(1.f)), _mm_set1_ps(-1.f));
+}
+
+SIMD_TARGET_SSE41
+static __m128i XorshiftSse41(__m128i x)
+{
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+
+SIMD_TARGET_SSE41
+static __m128 UniformSse41(__m128i x)
+{
+    return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)), _mm_set1_ps(1.f / 16777216.f));
+}
+
+// see NoiseScalar; state and noise are the lower and upper four lanes
+SIMD_TARGET_SSE41
+static void NoiseSse41(__m128i* state, __m128* noise)
+{
+    for(int h = 0; h < 2; ++h) {
+        __m128i a = XorshiftSse41(state[h]);
+        __m128i b = XorshiftSse41(a);
+        state[h] = b;
+        noise[h] = _mm_sub_ps(UniformSse41(a), UniformSse41(b));
+    }
+}
+
+// clips, scales, adds the noise and rounds
+SIMD_TARGET_SSE41
+static __m128i QuantizeSse41(float const* in, __m128 scale, __m128 noise)
+{
+    return _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(ClipSse41(_mm_loadu_ps(in)), scale), noise));
+}
+
+SIMD_TARGET_SSE41
+static void FromFloatSse41(PcmFormat format, float const* in, uint8_t* out, size_t n, uint32_t* dither)
+{
+    size_t i = 0;
+    __m128i state[2];
+    __m128 noise[2] = { _mm_setzero_ps(), _mm_setzero_ps() };
+    if(dither) {
+        state[0] = _mm_loadu_si128((__m128i const*)dither);
+        state[1] = _mm_loadu_si128((__m128i const*)(dither + 4));
+    }
+
+    switch(format) {
+    case PcmFormat::U8:
+        {
+            __m128 scale = _mm_set1_ps(u8Scale);
+            __m128i bias = _mm_set1_epi16(128);
+            for(; i + 8 <= n; i += 8) {
+                if(dither) NoiseSse41(state, noise);
+                __m128i lo = QuantizeSse41(in + i, scale, noise[0]);
+                __m128i hi = QuantizeSse41(in + i + 4, scale, noise[1]);
+                __m128i x = _mm_add_epi16(_mm_packs_epi32(lo, hi), bias);
+                _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(x, x));
+            }
+        }
+        break;
+    case PcmFormat::S16:
+        {
+            __m128 scale = _mm_set1_ps(s16Scale);
+            for(; i + 8 <= n; i += 8) {
+                if(dither) NoiseSse41(state, noise);
+                __m128i lo = QuantizeSse41(in + i, scale, noise[0]);
+                __m128i hi = QuantizeSse41(in + i + 4, scale, noise[1]);
+                _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_packs_epi32(lo, hi));
+            }
+        }
+        break;
+    case PcmFormat::S24:
+        {
+            // drop the top byte of each lane; the last four bytes of each
+            // store are garbage and get overwritten by the next one
+            __m128i shuffle = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            __m128 scale = _mm_set1_ps(s24Scale);
+            __m128i low = _mm_set1_epi32(-8388608), high = _mm_set1_epi32(8388607);
+            for(; 3 * i + 28 <= 3 * n; i += 8) {
+                if(dither) NoiseSse41(state, noise);
+                __m128i lo = QuantizeSse41(in + i, scale, noise[0]);
+                __m128i hi = QuantizeSse41(in + i + 4, scale, noise[1]);
+                lo = _mm_min_epi32(_mm_max_epi32(lo, low), high);
+                hi = _mm_min_epi32(_mm_max_epi32(hi, low), high);
+                _mm_storeu_si128((__m128i*)(out + 3 * i), _mm_shuffle_epi8(lo, shuffle));
+                _mm_storeu_si128((__m128i*)(out + 3 * i + 12), _mm_shuffle_epi8(hi, shuffle));
+            }
+        }
+        break;
+    case PcmFormat::S32:
+        {
+            __m128d scale = _mm_set1_pd(s32Scale);
+            for(; i + 4 <= n; i += 4) {
+                __m128 x = ClipSse41(_mm_loadu_ps(in + i));
+                __m128i lo = _mm_cvtpd_epi32(_mm_mul_pd(_mm_cvtps_pd(x), scale));
+                __m128i hi = _mm_cvtpd_epi32(_mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(x, x)), scale));
+                _mm_storeu_si128((__m128i*)(out + 4 * i), _mm_unpacklo_epi64(lo, hi));
+            }
+        }
+        break;
+    case PcmFormat::F32:
+        break;
+    case PcmFormat::F64:
+        for(; i + 4 <= n; i += 4) {
+            __m128 x = _mm_loadu_ps(in + i);
+            _mm_storeu_pd((double*)(out + 8 * i), _mm_cvtps_pd(x));
+            _mm_storeu_pd((double*)(out + 8 * i + 16), _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+        }
+        break;
+    }
+
+    if(dither) {
+        _mm_storeu_si128((__m128i*)dither, state[0]);
+        _mm_storeu_si128((__m128i*)(dither + 4), state[1]);
+    }
+    FromFloatScalar(format, in, out, i, n, dither);
+}
+
+/* AVX2 *****************************************************************/
+
+SIMD_TARGET_AVX2
+static void ToFloatAvx2(PcmFormat format, uint8_t const* in, float* out, size_t n)
+{
+    size_t i = 0;
+    switch(format) {
+    case PcmFormat::U8:
+        {
+            __m256i bias = _mm256_set1_epi32(128);
+            __m256 scale = _mm256_set1_ps(u8Scale);
+            for(; i + 8 <= n; i += 8) {
+                __m256i x = _mm256_sub_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)(in + i))), bias);
+                _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::S16:
+        {
+            __m256 scale = _mm256_set1_ps(s16Scale);
+            for(; i + 8 <= n; i += 8) {
+                __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((__m128i const*)(in + 2 * i)));
+                _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::S24:
+        {
+            // shuffles work within 128bit lanes, so each lane gets its own
+            // 12 bytes
+            __m256i shuffle = _mm256_setr_epi8(
+                    -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                    -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            __m256 scale = _mm256_set1_ps(s24Scale);
+            for(; 3 * i + 28 <= 3 * n; i += 8) {
+                __m128i lo = _mm_loadu_si128((__m128i const*)(in + 3 * i));
+                __m128i hi = _mm_loadu_si128((__m128i const*)(in + 3 * i + 12));
+                __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                __m256i x = _mm256_srai_epi32(_mm256_shuffle_epi8(bytes, shuffle), 8);
+                _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::S32:
+        {
+            __m256 scale = _mm256_set1_ps((float)s32Scale);
+            for(; i + 8 <= n; i += 8) {
+                __m256i x = _mm256_loadu_si256((__m256i const*)(in + 4 * i));
+                _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(x), scale));
+            }
+        }
+        break;
+    case PcmFormat::F32:
+        break;
+    case PcmFormat::F64:
+        for(; i + 8 <= n; i += 8) {
+            __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd((double const*)(in + 8 * i)));
+            __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd((double const*)(in + 8 * i + 32)));
+            _mm256_storeu_ps(out + i, _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1));
+        }
+        break;
+    }
+    ToFloatScalar(format, in, out, i, n);
+}
+
+SIMD_TARGET_AVX2
+static __m256 ClipAvx2(__m256 x)
+{
+    return _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(1.f)), _mm256_set1_ps(-1.f));
+}
+
+// see NoiseScalar
+SIMD_TARGET_AVX2
+static __m256 NoiseAvx2(__m256i& state)
+{
+    __m256i a = state;
+    a = _mm256_xor_si256(a, _mm256_slli_epi32(a, 13));
+    a = _mm256_xor_si256(a, _mm256_srli_epi32(a, 17));
+    a = _mm256_xor_si256(a, _mm256_slli_epi32(a, 5));
+    __m256i b = a;
+    b = _mm256_xor_si256(b, _mm256_slli_epi32(b, 13));
+    b = _mm256_xor_si256(b, _mm256_srli_epi32(b, 17));
+    b = _mm256_xor_si256(b, _mm256_slli_epi32(b, 5));
+    state = b;
+
+    __m256 unit = _mm256_set1_ps(1.f / 16777216.f);
+    __m256 ua = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(a, 8)), unit);
+    __m256 ub = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(b, 8)), unit);
+    return _mm256_sub_ps(ua, ub);
+}
+
+// clips, scales, adds the noise and rounds
+SIMD_TARGET_AVX2
+static __m256i QuantizeAvx2(float const* in, __m256 scale, __m256 noise)
+{
+    return _mm256_cvtps_epi32(_mm256_add_ps(_mm256_mul_ps(ClipAvx2(_mm256_loadu_ps(in)), scale), noise));
+}
+
+SIMD_TARGET_AVX2
+static void FromFloatAvx2(PcmFormat format, float const* in, uint8_t* out, size_t n, uint32_t* dither)
+{
+    size_t i = 0;
+    __m256i state = _mm256_setzero_si256();
+    __m256 noise = _mm256_setzero_ps();
+    if(dither) state = _mm256_loadu_si256((__m256i const*)dither);
+
+    switch(format) {
+    case PcmFormat::U8:
+        {
+            __m256 scale = _mm256_set1_ps(u8Scale);
+            __m128i bias = _mm_set1_epi16(128);
+            for(; i + 8 <= n; i += 8) {
+                if(dither) noise = NoiseAvx2(state);
+                __m256i x = QuantizeAvx2(in + i, scale, noise);
+                __m128i x16 = _mm_add_epi16(_mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)), bias);
+                _mm_storel_epi64((__m128i*)(out + i), _mm_packus_epi16(x16, x16));
+            }
+        }
+        break;
+    case PcmFormat::S16:
+        {
+            __m256 scale = _mm256_set1_ps(s16Scale);
+            for(; i + 8 <= n; i += 8) {
+                if(dither) noise = NoiseAvx2(state);
+                __m256i x = QuantizeAvx2(in + i, scale, noise);
+                _mm_storeu_si128((__m128i*)(out + 2 * i), _mm_packs_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+            }
+        }
+        break;
+    case PcmFormat::S24:
+        {
+            __m256i shuffle = _mm256_setr_epi8(
+                    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                    0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            __m256 scale = _mm256_set1_ps(s24Scale);
+            __m256i low = _mm256_set1_epi32(-8388608), high = _mm256_set1_epi32(8388607);
+            for(; 3 * i + 28 <= 3 * n; i += 8) {
+                if(dither) noise = NoiseAvx2(state);
+                __m256i x = QuantizeAvx2(in + i, scale, noise);
+                x = _mm256_shuffle_epi8(_mm256_min_epi32(_mm256_max_epi32(x, low), high), shuffle);
+                _mm_storeu_si128((__m128i*)(out + 3 * i), _mm256_castsi256_si128(x));
+                _mm_storeu_si128((__m128i*)(out + 3 * i + 12), _mm256_extracti128_si256(x, 1));
+            }
+        }
+        break;
+    case PcmFormat::S32:
+        {
+            __m256d scale = _mm256_set1_pd(s32Scale);
+            for(; i + 8 <= n; i += 8) {
+                __m256 x = ClipAvx2(_mm256_loadu_ps(in + i));
+                __m128i lo = _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(x)), scale));
+                __m128i hi = _mm256_cvtpd_epi32(_mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)), scale));
+                _mm_storeu_si128((__m128i*)(out + 4 * i), lo);
+                _mm_storeu_si128((__m128i*)(out + 4 * i + 16), hi);
+            }
+        }
+        break;
+    case PcmFormat::F32:
+        break;
+    case PcmFormat::F64:
+        for(; i + 8 <= n; i += 8) {
+            __m256 x = _mm256_loadu_ps(in + i);
+            _mm256_storeu_pd((double*)(out + 8 * i), _mm256_cvtps_pd(_mm256_castps256_ps128(x)));
+            _mm256_storeu_pd((double*)(out + 8 * i + 32), _mm256_cvtps_pd(_mm256_extractf128_ps(x, 1)));
+        }
+        break;
+    }
+
+    if(dither) _mm256_storeu_si256((__m256i*)dither, state);
+    FromFloatScalar(format, in, out, i, n, dither);
+}
+
+static const bool hasAvx2 = CpuHasAvx2();
+static const bool hasSse41 = CpuHasSse41();
+
+void PcmToFloat(PcmFormat format, void const* in, float* out, size_t n)
+{
+    if(hasAvx2) ToFloatAvx2(format, (uint8_t const*)in, out, n);
+    else if(hasSse41) ToFloatSse41(format, (uint8_t const*)in, out, n);
+    else ToFloatScalar(format, (uint8_t const*)in, out, 0, n);
+}
+
+PcmDither::PcmDither(uint32_t seed)
+{
+    // xorshift gets stuck at 0
+    for(size_t k = 0; k < lanes; ++k) {
+        state[k] = Xorshift((seed + (uint32_t)k) * 0x9E3779B9u) | 1;
+    }
+}
+
+void FloatToPcm(PcmFormat format, float const* in, void* out, size_t n, PcmDither* dither)
+{
+    // only worth it for formats with fewer bits than a float
+    uint32_t* state = (dither && (format == PcmFormat::U8 || format == PcmFormat::S16 || format == PcmFormat::S24))
+        ? dither->state : nullptr;
+    if(hasAvx2) FromFloatAvx2(format, in, (uint8_t*)out, n, state);
+    else if(hasSse41) FromFloatSse41(format, in, (uint8_t*)out, n, state);
+    else FromFloatScalar(format, in, (uint8_t*)out, 0, n, state);
+}
+
+#ifdef BENCH_PCM
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <random>
+int main()
+{
+    const size_t n = 1 << 20;
+    PcmFormat formats[] = { PcmFormat::U8, PcmFormat::S16, PcmFormat::S24, PcmFormat::S32, PcmFormat::F32, PcmFormat::F64 };
+    char const* names[] = { "u8", "s16", "s24", "s32", "f32", "f64" };
+
+    // a bit past full scale so clipping gets exercised too; odd sizes
+    // leave a tail for the scalar code
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(-1.2f, 1.2f);
+    std::vector<float> in(n + 7);
+    for(auto&& x: in) x = dist(rng);
+
+    printf("%s\n", hasAvx2 ? "avx2" : hasSse41 ? "sse4.1" : "scalar");
+    for(size_t k = 0; k < sizeof(formats) / sizeof(formats[0]); ++k) {
+        PcmFormat format = formats[k];
+        size_t size = in.size() * PcmSampleSize(format);
+        std::vector<uint8_t> pcm(size), expectPcm(size);
+        std::vector<float> out(in.size()), expectOut(in.size());
+
+        auto start = std::chrono::steady_clock::now();
+        FloatToPcm(format, in.data(), pcm.data(), in.size());
+        auto mid = std::chrono::steady_clock::now();
+        PcmToFloat(format, pcm.data(), out.data(), in.size());
+        auto end = std::chrono::steady_clock::now();
+
+        FromFloatScalar(format, in.data(), expectPcm.data(), 0, in.size(), nullptr);
+        ToFloatScalar(format, expectPcm.data(), expectOut.data(), 0, in.size());
+        bool same = (pcm == expectPcm) && memcmp(out.data(), expectOut.data(), out.size() * sizeof(float)) == 0;
+
+        printf("%-4s from float %5.2f ns/sample  to float %5.2f ns/sample  %s\n", names[k],
+                std::chrono::duration<double, std::nano>(mid - start).count() / in.size(),
+                std::chrono::duration<double, std::nano>(end - mid).count() / in.size(),
+                same ? "matches scalar" : "DIFFERS FROM SCALAR");
+    }
+
+    // dithered, in uneven chunks so the generators carry over between
+    // calls and tails; a quiet signal shows how much noise gets added
+    for(size_t k = 0; k < 3; ++k) {
+        PcmFormat format = formats[k];
+        size_t sampleSize = PcmSampleSize(format);
+        std::vector<float> quiet(in.size());
+        for(size_t i = 0; i < in.size(); ++i) quiet[i] = in[i] * 0.01f;
+        std::vector<uint8_t> pcm(in.size() * sampleSize), expectPcm(in.size() * sampleSize);
+        std::vector<float> out(in.size());
+
+        PcmDither dither, expectDither;
+        double elapsed = 0.0;
+        for(size_t i = 0, chunk = 1; i < in.size(); i += chunk, chunk = chunk * 3 % 1013 + 1) {
+            size_t m = std::min(chunk, in.size() - i);
+            auto start = std::chrono::steady_clock::now();
+            FloatToPcm(format, &quiet[i], &pcm[i * sampleSize], m, &dither);
+            auto end = std::chrono::steady_clock::now();
+            elapsed += std::chrono::duration<double, std::nano>(end - start).count();
+            FromFloatScalar(format, &quiet[i], &expectPcm[i * sampleSize], 0, m, expectDither.state);
+        }
+        PcmToFloat(format, pcm.data(), out.data(), in.size());
+
+        float lsb = 1.f / ((format == PcmFormat::U8) ? u8Scale : (format == PcmFormat::S16) ? s16Scale : s24Scale);
+        double mean = 0.0, power = 0.0, worst = 0.0;
+        for(size_t i = 0; i < in.size(); ++i) {
+            double e = (out[i] - quiet[i]) / lsb;
+            mean += e;
+            power += e * e;
+            worst = std::max(worst, std::fabs(e));
+        }
+        printf("%-4s dithered   %5.2f ns/sample  error mean %+.3f rms %.3f max %.2f LSB  %s\n", names[k],
+                elapsed / in.size(), mean / in.size(), std::sqrt(power / in.size()), worst,
+                (pcm == expectPcm) ? "matches scalar" : "DIFFERS FROM SCALAR");
+    }
+}
+#endif
@@ -0,0 +1,74 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PCM_H
+#define PCM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Little endian sample formats found in wave files.
+enum class PcmFormat
+{
+    U8, // unsigned, 128 is silence
+    S16,
+    S24, // packed, 3 bytes per sample
+    S32,
+    F32,
+    F64
+};
+
+// bytes per sample
+size_t PcmSampleSize(PcmFormat format);
+
+// parses the name of a format as given on the command line, e.g. s16
+bool ParsePcmFormat(std::wstring const& name, PcmFormat& format);
+
+// Converts n samples to floats. Integers are scaled so that their
+// largest positive value becomes 1 (the most negative one ends up a tiny
+// bit below -1). in needn't be aligned.
+void PcmToFloat(PcmFormat format, void const* in, float* out, size_t n);
+
+// TPDF dither: the difference of two uniform random numbers, spanning
+// +-1 LSB, added to each sample before it's rounded. The numbers come from
+// eight interleaved xorshift generators, so they're the same whichever
+// code path does the conversion.
+struct PcmDither
+{
+    static const size_t lanes = 8;
+    uint32_t state[lanes];
+
+    explicit PcmDither(uint32_t seed = 1);
+};
+
+// Converts n floats, clipped to [-1, 1] and rounded to the nearest
+// integer, the other way around. out needn't be aligned. With dither,
+// u8, s16 and s24 get dithered; the rest have more precision than a
+// float anyway.
+void FloatToPcm(PcmFormat format, float const* in, void* out, size_t n, PcmDither* dither = nullptr);
+
+#endif
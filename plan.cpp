@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <plan.h>
+#include <algorithm>
+
+UnusedAssets FindUnused(File const& f)
+{
+    UnusedAssets unused;
+
+    std::vector<bool> phrases(f.phrases.size(), false);
+    std::vector<bool> samples(f.samples.size(), false);
+    for(unsigned id: f.output) phrases[id] = true;
+    for(unsigned id = 0; id < f.phrases.size(); ++id) {
+        if(!phrases[id]) {
+            unused.phrases.push_back(id);
+            continue;
+        }
+        auto&& phrase = f.phrases[id];
+        for(size_t row = 0; row < phrase.samples.size(); ++row) {
+            // rests and stops alone never make a sound; the two bits of
+            // a HALF or a FULL are the only ones which differ
+            auto words = phrase.Row(row);
+            bool hit = std::any_of(words, words + phrase.rowWords, [](uint64_t w) {
+                        return ((w ^ (w >> 1)) & 0x5555555555555555ull) != 0;
+                    });
+            if(hit) samples[phrase.samples[row]] = true;
+        }
+    }
+    for(unsigned id = 0; id < f.samples.size(); ++id) {
+        if(!samples[id]) unused.samples.push_back(id);
+    }
+
+    return unused;
+}
+
+RenderPlan Compile(File const& f, UnusedAssets const& unused)
+{
+    RenderPlan plan;
+
+    // lay out the song
+    struct Occurrence {
+        File::Phrase const* phrase;
+        size_t numSamplesPerBeat;
+    };
+    std::vector<Occurrence> occurrences;
+    occurrences.reserve(f.output.size());
+    plan.output = f.output;
+    plan.numPhrases = (unsigned)f.phrases.size();
+    plan.phraseStarts.reserve(f.output.size() + 1);
+
+    size_t i = 0;
+    for(unsigned id: f.output) {
+        auto&& phrase = f.phrases[id];
+        size_t numSamplesPerBeat = 44100 * 60 / phrase.bpm;
+        occurrences.push_back({ &phrase, numSamplesPerBeat });
+        plan.phraseStarts.push_back(i);
+        i += phrase.length * numSamplesPerBeat;
+    }
+    plan.phraseStarts.push_back(i);
+    plan.length = i;
+
+    std::vector<bool> skip(f.samples.size(), false);
+    for(unsigned id: unused.samples) skip[id] = true;
+
+    // flatten the beats of each track
+    plan.tracks.reserve(f.samples.size() - unused.samples.size());
+    for(unsigned sample = 0; sample < f.samples.size(); ++sample) {
+        if(skip[sample]) continue;
+        unsigned id = (unsigned)plan.tracks.size();
+        RenderPlan::Track track;
+        track.sample = sample;
+        track.volume = (float)f.samples[sample].volume / 100.f;
+        track.voices = (unsigned)f.samples[sample].voices;
+        track.effect = f.samples[sample].effect;
+        track.firstEvent = plan.events.size();
+
+        for(size_t j = 0; j < occurrences.size(); ++j) {
+            auto&& phrase = *occurrences[j].phrase;
+            auto&& found = std::lower_bound(phrase.samples.begin(), phrase.samples.end(), sample);
+            if(found == phrase.samples.end() || *found != sample) continue;
+
+            size_t start = plan.phraseStarts[j];
+            size_t numSamplesPerBeat = occurrences[j].numSamplesPerBeat;
+            phrase.ForEachHit(found - phrase.samples.begin(), [&](size_t b, File::Beat beat) {
+                size_t offset = start + b * numSamplesPerBeat;
+                switch(beat) {
+                case File::Beat::REST:
+                    break;
+                case File::Beat::HALF:
+                    plan.events.push_back({ offset, id, 0.5f, false });
+                    break;
+                case File::Beat::FULL:
+                    plan.events.push_back({ offset, id, 1.f, false });
+                    break;
+                case File::Beat::STOP:
+                    plan.events.push_back({ offset, id, 0.f, true });
+                    break;
+                }
+            });
+        }
+
+        track.numEvents = plan.events.size() - track.firstEvent;
+        plan.tracks.push_back(track);
+    }
+
+    return plan;
+}
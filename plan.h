@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef PLAN_H
+#define PLAN_H
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <file.h>
+
+// A File compiled down to what the renderer actually needs: every lookup
+// by name is resolved up front, phrase lengths are summed into absolute
+// offsets and beats are flattened into trigger events.
+struct RenderPlan
+{
+    struct Track
+    {
+        unsigned sample; // ID in File::samples
+        float volume;
+        unsigned voices;
+        std::shared_ptr<File::Sample::Effect> effect;
+        size_t firstEvent; // index into events
+        size_t numEvents;
+    };
+
+    struct Event
+    {
+        size_t offset; // in samples, from the start of the song
+        unsigned track;
+        float gain;
+        bool stop;
+    };
+
+    std::vector<Track> tracks;
+    std::vector<unsigned> output; // the phrase ID of each entry in File::output
+    unsigned numPhrases; // IDs in output are below this
+    std::vector<size_t> phraseStarts; // one per entry in output, plus the song length
+    std::vector<Event> events; // sorted by track, then by offset
+    size_t length; // in samples
+};
+
+// IDs of what a File defines but never plays.
+struct UnusedAssets
+{
+    std::vector<unsigned> phrases;
+    std::vector<unsigned> samples;
+};
+
+// Finds the phrases Output never plays and the samples which none of the
+// other phrases ever hit, so they're neither loaded nor rendered.
+UnusedAssets FindUnused(File const& f);
+
+// Unused samples get no track.
+RenderPlan Compile(File const& f, UnusedAssets const& unused);
+
+#endif
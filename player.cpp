@@ -0,0 +1,137 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <player.h>
+#include <errorassert.h>
+#include <algorithm>
+#include <cstring>
+
+#ifdef JAKBEAT_NO_SDL
+Player::Player(unsigned, unsigned, size_t bufferFrames)
+    : ring(bufferFrames)
+{
+    ASSERT(false, L"This build of jakbeat has no live playback; it was built without SDL");
+}
+
+Player::~Player() {}
+void Player::Write(float const*, size_t) {}
+void Player::Close() {}
+#else
+#include <SDL.h>
+
+Player::Player(unsigned samplesPerSecond_, unsigned numChannels_, size_t bufferFrames)
+    : ring(bufferFrames * numChannels_)
+    , samplesPerSecond(samplesPerSecond_)
+    , numChannels(numChannels_)
+    , deviceFrames(256)
+    , device(0)
+    , started(false)
+    , finished(false)
+    , underruns(0)
+{
+    // the device asks for a quarter of the ring buffer at a time, so
+    // there's still something queued up while the renderer catches up
+    while(deviceFrames < 4096 && deviceFrames * 2 * 4 * numChannels <= ring.Capacity()) {
+        deviceFrames *= 2;
+    }
+
+    ASSERT(SDL_InitSubSystem(SDL_INIT_AUDIO) == 0, L"SDL_InitSubSystem failed: ", SDL_GetError());
+
+    SDL_AudioSpec desired;
+    memset(&desired, 0, sizeof(desired));
+    desired.freq = samplesPerSecond;
+    desired.format = AUDIO_F32SYS;
+    desired.channels = numChannels;
+    desired.samples = deviceFrames;
+    desired.callback = &Player::Callback;
+    desired.userdata = this;
+    // SDL converts to whatever the device wants
+    device = SDL_OpenAudioDevice(nullptr, 0, &desired, nullptr, 0);
+    ASSERT(device != 0, L"SDL_OpenAudioDevice failed: ", SDL_GetError());
+}
+
+Player::~Player()
+{
+    if(device) {
+        SDL_CloseAudioDevice(device);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+}
+
+void Player::Callback(void* userdata, uint8_t* stream, int len)
+{
+    auto self = (Player*)userdata;
+    float* out = (float*)stream;
+    size_t wanted = len / sizeof(float);
+
+    // whole frames only, or the channels would get swapped around
+    size_t ready = self->ring.Available() / self->numChannels * self->numChannels;
+    size_t n = self->ring.Read(out, std::min(wanted, ready));
+    if(n < wanted) {
+        std::fill(out + n, out + wanted, 0.f);
+        if(!self->finished) ++self->underruns;
+    }
+}
+
+void Player::Start()
+{
+    if(started) return;
+    SDL_PauseAudioDevice(device, 0);
+    started = true;
+}
+
+void Player::Write(float const* samples, size_t numFrames)
+{
+    size_t n = numFrames * numChannels;
+    while(n > 0) {
+        size_t written = ring.Write(samples, n);
+        samples += written;
+        n -= written;
+        if(n > 0) {
+            Start();
+            // about how long the device takes to eat a quarter of it
+            SDL_Delay((Uint32)(ring.Capacity() / numChannels * 1000 / samplesPerSecond / 4) + 1);
+        }
+    }
+}
+
+void Player::Close()
+{
+    if(!device) return;
+
+    finished = true;
+    Start();
+    while(ring.Available() > 0) {
+        SDL_Delay(10);
+    }
+    // let the device play out its last buffer
+    SDL_Delay(deviceFrames * 1000 / samplesPerSecond + 10);
+
+    SDL_CloseAudioDevice(device);
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    device = 0;
+}
+#endif
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <sink.h>
+#include <ringbuffer.h>
+#include <atomic>
+#include <cstdint>
+
+// Plays frames through the default SDL audio device as they're written.
+// Write queues them in a ring buffer which the audio callback drains,
+// blocking while the ring buffer is full. Playback starts once the ring
+// buffer fills up for the first time (or on Close, for short songs) and
+// Close waits for everything to be played.
+//
+// SDL picks the device from SDL_AUDIODRIVER, so SDL_AUDIODRIVER=dummy
+// or SDL_AUDIODRIVER=disk work on machines without a sound card.
+struct Player : Sink
+{
+    Player(unsigned samplesPerSecond, unsigned numChannels, size_t bufferFrames);
+    ~Player();
+
+    void Write(float const* samples, size_t numFrames) override;
+    void Close() override;
+
+    // how many times the audio device asked for more than was ready
+    size_t Underruns() const { return underruns; }
+
+private:
+    static void Callback(void* userdata, uint8_t* stream, int len);
+    void Start();
+
+    RingBuffer ring;
+    unsigned samplesPerSecond;
+    unsigned numChannels;
+    unsigned deviceFrames;
+    uint32_t device;
+    bool started;
+    std::atomic<bool> finished;
+    std::atomic<size_t> underruns;
+
+    Player(Player const&) = delete;
+    Player& operator=(Player const&) = delete;
+};
+
+#endif
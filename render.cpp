@@ -27,7 +27,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <file.h>
 #include <parser_types.h>
 #include <map>
-#include <SDL.h>
 #include <errorassert.h>
 #include <cmath>
 #include <algorithm>
@@ -36,249 +35,567 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <iterator>
 #include <type_traits>
 #include <string_utils.h>
+#include <plan.h>
+#include <render.h>
+#include <parallel.h>
+#include <wave.h>
+#include <player.h>
+#include <sample.h>
+#include <mix.h>
+#include <memory>
+#include <atomic>
+#include <exception>
 
-std::map<std::wstring, std::vector<float>> LoadData(File& f)
+// Loads the sample of every track once per distinct path, on the threads
+// of the pool; samples sharing a path share the data. Every file that
+// fails to load is reported before giving up.
+std::vector<std::shared_ptr<SampleData const>> LoadData(File const& f, RenderPlan const& plan, RenderOptions const& options, ThreadPool& pool)
 {
-    std::map<std::wstring, std::vector<float>> data;
-    for(auto&& sample: f.samples) {
-        auto& wav = data[sample.first];
-        auto path = sample.second.path;
-        Uint8* sdlWavData = nullptr;
-        Uint32 len = 0;
-        SDL_AudioSpec desired = {
-            44100,
-            AUDIO_F32SYS,
-            1,
-            0,
-            4096,
-            0
-        };
-        desired.callback = nullptr;
-        desired.userdata = nullptr;
-        auto wpath = W2MB(path);
-        auto hr = SDL_LoadWAV(
-                wpath.get(),
-                &desired,
-                &sdlWavData,
-                &len);
-        if(hr == nullptr) {
-            fwprintf(stderr, L"SDL_LoadWAV failed: %s\n", SDL_GetError());
-            abort();
-        }
-        ASSERT(desired.freq == 44100 && (desired.format == AUDIO_F32SYS || desired.format == AUDIO_F32 || desired.format == AUDIO_F32LSB || desired.format == AUDIO_S16LSB) && desired.channels == 1,
-                L"Expecting a mono sample at 44100Hz either in float32 format or signed 16bit little endian; got sample rate ", desired.freq,
-                L", channels ", desired.channels,
-                L" and format code ", desired.format);
-        if(desired.format == AUDIO_S16LSB) {
-            wav.resize(len / sizeof(int16_t));
-            int16_t* shorts = (int16_t*)sdlWavData;
-            for(size_t i = 0; i < len/sizeof(int16_t); ++i) {
-                wav[i] = (float)shorts[i]/(float)0x7FFF;
-            }
-        } else {
-            wav.resize(len / sizeof(float));
-            memcpy(wav.data(), sdlWavData, len);
+    std::vector<std::wstring> paths;
+    std::map<std::wstring, size_t> pathIndices;
+    std::vector<size_t> trackPaths;
+    for(auto&& track: plan.tracks) {
+        auto&& path = f.samples[track.sample].path;
+        auto&& inserted = pathIndices.emplace(path, paths.size());
+        if(inserted.second) paths.push_back(path);
+        trackPaths.push_back(inserted.first->second);
+    }
+
+    std::vector<std::shared_ptr<SampleData const>> loaded(paths.size());
+    std::vector<std::string> errors(paths.size());
+    std::vector<char> cached(paths.size(), 0);
+    ParallelFor(pool, paths.size(), [&](size_t i) {
+        try {
+            bool fromCache = false;
+            loaded[i] = LoadSample(paths[i], options.resampleQuality, options.cacheDir, &fromCache);
+            cached[i] = fromCache;
+        } catch(std::exception& e) {
+            errors[i] = e.what();
         }
-        SDL_FreeWAV(sdlWavData);
+    });
+
+    size_t failed = 0;
+    for(size_t i = 0; i < paths.size(); ++i) {
+        if(loaded[i]) continue;
+        fwprintf(stderr, L"Failed to load %ls: %ls\n", paths[i].c_str(), MB2W(errors[i].c_str()).c_str());
+        ++failed;
+    }
+    ASSERT(failed == 0, failed, L" of ", paths.size(), L" sample files failed to load");
+
+    std::vector<std::shared_ptr<SampleData const>> data;
+    for(size_t i: trackPaths) {
+        data.push_back(loaded[i]);
     }
-    return std::move(data);
+
+    if(options.stats) {
+        fwprintf(stderr, L"Loaded %lu samples from %lu files, %lu of them from the cache\n",
+                (unsigned long)plan.tracks.size(),
+                (unsigned long)paths.size(),
+                (unsigned long)std::count(cached.begin(), cached.end(), 1));
+    }
+    return data;
 }
 
 #define RenderNew Render
 
-void RenderNew(File f, std::wstring filename, bool split)
+// effects are fed this many samples at a time
+static const size_t blockSize = 256;
+// tracks are mixed this many frames at a time; small enough for every
+// track's block to stay in cache until it's mixed
+static const size_t mixFrames = 256;
+// each job renders this many frames between synchronisations
+static const size_t sliceFrames = 32 * mixFrames;
+// at most this many recordings are kept of each phrase on each track
+static const size_t memoEntriesPerPhrase = 4;
+// total size of all recordings, with their end states
+static const long long memoBudget = 256ll * 1024 * 1024;
+
+namespace {
+    // a hit which is still ringing
+    struct Voice
+    {
+        size_t ptr; // into the sample data; always before the end
+        float gain;
+    };
+
+    // where a track's sample playback is at; voices live in place so
+    // this can be copied around without touching the heap
+    struct Playback
+    {
+        Voice voices[File::Sample::maxVoices]; // oldest first
+        unsigned numVoices;
+        size_t nextEvent; // into RenderPlan::events
+        size_t nextPhrase; // into RenderPlan::phraseStarts
+    };
+
+    // A rendering of a phrase on one track, from a state with nothing
+    // playing and an effect that hashed to hash.
+    struct MemoEntry
+    {
+        unsigned phrase;
+        uint64_t hash;
+        size_t start, end;
+        std::vector<float> left, right;
+        // the state right after the phrase
+        Playback endPlayback;
+        std::unique_ptr<StereoInstance> endEffect;
+    };
+
+    // what was decided when a track reached an entry in RenderPlan::output
+    struct MemoOccurrence
+    {
+        int entry; // -1 if not memoized
+        bool hit; // copied from entry, otherwise being recorded into it
+        size_t eventsEnd; // RenderPlan::events index past the phrase
+    };
+
+    // Repeated phrases on one track. Only the track's lead state makes
+    // decisions and records end states; the other slices follow them.
+    struct TrackMemo
+    {
+        // preallocated for the phrases which repeat; never reallocates
+        std::vector<MemoEntry> entries;
+        size_t numEntries = 0;
+        std::vector<MemoOccurrence> occurrences;
+        std::vector<bool> const* repeats; // if an output entry repeats later
+        std::atomic<long long>* budget;
+        size_t lookups = 0, hits = 0;
+    };
+}
+
+// Called when track t reaches the start of output entry pb.nextPhrase.
+static void EnterPhrase(
+        RenderPlan const& plan,
+        unsigned t,
+        Playback& pb,
+        StereoInstance& effect,
+        TrackMemo& memo,
+        bool lead,
+        size_t ready)
 {
-    std::map<std::wstring, std::vector<float>> data = LoadData(f);
-    std::map<std::wstring, std::pair<std::vector<float>, std::vector<float>>> unmixed;
-    size_t end = 0;
-
-    for(auto&& track: f.samples) {
-        size_t i = 0;
-        auto&& leftData = unmixed[track.first].first;
-        auto&& rightData = unmixed[track.first].second;
-        float gain = 0.f;
-        float volume = (float)track.second.volume / 100.f;
-        auto&& mydata = data[track.first];
-        std::remove_reference<decltype(mydata)>::type::iterator ptr = mydata.end();
-
-        for(auto&& name: f.output) {
-            auto&& phrase = f.phrases[name];
-            size_t numSamplesPerBeat = 44100 * 60 / phrase.bpm;
-            size_t numBeats = std::accumulate(
-                    phrase.beats.begin(), phrase.beats.end(), (size_t)0,
-                    [](size_t a, decltype(phrase.beats)::value_type b) -> size_t {
-                        return std::max(a, b.second.size());
-                    }
-                    );
-            size_t newestI = i + numBeats * numSamplesPerBeat;
-
-            auto&& found = phrase.beats.find(track.first);
-            if(found == phrase.beats.end()) {
-				for (size_t k = 0; k < numSamplesPerBeat * numBeats && ptr != mydata.end(); ++k, ++ptr) {
-						while (i + k >= leftData.size()) leftData.emplace_back();
-						while (i + k >= rightData.size()) rightData.emplace_back();
-                        auto data = track.second.effect->apply(gain * (*ptr) * volume);
-						leftData[i + k] = data.data[0];
-						rightData[i + k] = data.data[1];
-				}
-                auto startLeft = leftData.size();
-                auto startRight = rightData.size();
-                leftData.resize(i + numSamplesPerBeat * numBeats);
-                rightData.resize(i + numSamplesPerBeat * numBeats);
-                i += numSamplesPerBeat * numBeats;
-                for(auto j = startLeft; j < i; ++j) {
-                    leftData[j] = 0.f;
-                }
-                for(auto j = startRight; j < i; ++j) {
-                    rightData[j] = 0.f;
-                }
-            } else {
-                auto&& beats = phrase.beats[track.first];
-
-                for(auto&& beat: beats) {
-                    if(beat == File::Beat::REST
-                            || beat == File::Beat::STOP) {
-                        if(beat == File::Beat::STOP) {
-                            ptr = mydata.end();
-                            gain = 0.f;
-                        }
-                        for(size_t k = 0;
-                                k < numSamplesPerBeat && ptr != mydata.end();
-                                ++k, ++ptr)
-                        {
-                            while(i + k >= leftData.size()) leftData.emplace_back();
-                            while(i + k >= rightData.size()) rightData.emplace_back();
-                            auto data = track.second.effect->apply(gain * (*ptr) * volume);
-                            leftData[i + k] = data.data[0];
-                            rightData[i + k] = data.data[1];
-                        }
-                        i += numSamplesPerBeat;
-                        continue;
-                    } else if(beat == File::Beat::HALF) {
-                        gain = 0.5f;
-                    } else if(beat == File::Beat::FULL) {
-                        gain = 1.f;
-                    }
+    size_t k = pb.nextPhrase++;
 
-                    ptr = mydata.begin();
-                    for(size_t k = 0;
-                            k < numSamplesPerBeat && ptr != mydata.end();
-                            ++k, ++ptr)
-                    {
-                        while(i + k >= leftData.size()) leftData.emplace_back();
-                        while(i + k >= rightData.size()) rightData.emplace_back();
-                        auto data = track.second.effect->apply(gain * (*ptr) * volume);
-                        leftData[i + k] = data.data[0];
-                        rightData[i + k] = data.data[1];
-                    }
-                    i += numSamplesPerBeat;
-                }
-            }
+    if(k > 0) {
+        auto&& prev = memo.occurrences[k - 1];
+        if(prev.entry >= 0 && prev.hit) {
+            auto&& entry = memo.entries[prev.entry];
+            effect.Restore(*entry.endEffect);
+            size_t nextPhrase = pb.nextPhrase;
+            pb = entry.endPlayback;
+            pb.nextEvent = prev.eventsEnd;
+            pb.nextPhrase = nextPhrase;
+        } else if(prev.entry >= 0 && lead) {
+            auto&& entry = memo.entries[prev.entry];
+            entry.endEffect.reset(effect.Snapshot());
+            entry.endPlayback = pb;
+        }
+    }
+
+    if(!lead || k >= plan.output.size()) return;
+
+    auto&& occ = memo.occurrences[k];
+    occ = { -1, false, pb.nextEvent };
+    // a tail ringing in from before makes this occurrence unique
+    if(pb.numVoices > 0) return;
 
-            i = newestI;
+    size_t start = plan.phraseStarts[k];
+    size_t end = plan.phraseStarts[k + 1];
+    auto&& track = plan.tracks[t];
+    size_t lastEvent = track.firstEvent + track.numEvents;
+    while(occ.eventsEnd < lastEvent && plan.events[occ.eventsEnd].offset < end) {
+        ++occ.eventsEnd;
+    }
+    // nothing to play, nothing to save
+    if(occ.eventsEnd == pb.nextEvent) return;
+
+    ++memo.lookups;
+    unsigned phrase = plan.output[k];
+    uint64_t hash = effect.Hash();
+    size_t recorded = 0;
+    for(size_t e = 0; e < memo.numEntries; ++e) {
+        auto&& entry = memo.entries[e];
+        if(entry.phrase != phrase) continue;
+        ++recorded;
+        // entries still being rendered by the current window can't be used
+        if(entry.hash == hash && entry.end <= ready) {
+            occ.entry = (int)e;
+            occ.hit = true;
+            ++memo.hits;
+            return;
         }
     }
 
-    extern void wav_write_file(std::wstring const&, std::vector<float> const&, unsigned, unsigned);
+    if(!(*memo.repeats)[k] || recorded >= memoEntriesPerPhrase) return;
+    long long bytes = (long long)(2 * (end - start) * sizeof(float) + effect.SnapshotSize());
+    if(memo.budget->fetch_sub(bytes) < bytes) {
+        memo.budget->fetch_add(bytes);
+        return;
+    }
 
-    if(split)
-    {
-        size_t maxLen = 0;
-        maxLen = std::accumulate(unmixed.begin(), unmixed.end(), maxLen, [](size_t a, decltype(unmixed)::value_type const& b) -> size_t {
-                    return std::max(a, std::max(b.second.first.size(), b.second.second.size()));
-                });
+    auto&& entry = memo.entries[memo.numEntries];
+    entry.phrase = phrase;
+    entry.hash = hash;
+    entry.start = start;
+    entry.end = end;
+    entry.left.assign(end - start, 0.f);
+    entry.right.assign(end - start, 0.f);
+    occ.entry = (int)memo.numEntries++;
+}
 
-        for(auto&& channel : unmixed) {
-            std::wstringstream fnameBuilder;
-            fnameBuilder << filename << L"_" << channel.first << L".wav";
+// Renders track t from sample `from' up to sample `to' into left and
+// right, advancing pb and effect. If left is null, only the state is
+// advanced. Returns false if the track was silent the whole time, in
+// which case left and right are left untouched.
+//
+// Phrases are memoized in memo; lead is set for the track's lead state,
+// and ready is the sample up to which everything's been rendered.
+static bool RenderTrack(
+        RenderPlan const& plan,
+        unsigned t,
+        SampleData const& mydata,
+        Playback& pb,
+        StereoInstance& effect,
+        TrackMemo& memo,
+        bool lead,
+        size_t ready,
+        size_t from,
+        size_t to,
+        float* left,
+        float* right)
+{
+    auto&& track = plan.tracks[t];
+    float volume = track.volume;
+    size_t lastEvent = track.firstEvent + track.numEvents;
+    float block[blockSize];
+    float const* sources[File::Sample::maxVoices];
+    float gains[File::Sample::maxVoices];
+    bool played = false;
+
+    size_t i = from;
+    while(i < to) {
+        size_t phraseEnd = plan.length;
+        if(pb.nextPhrase < plan.phraseStarts.size()) {
+            phraseEnd = plan.phraseStarts[pb.nextPhrase];
+            if(phraseEnd == i) {
+                EnterPhrase(plan, t, pb, effect, memo, lead, ready);
+                continue;
+            }
+        }
 
-            std::vector<float> outWAV(maxLen * 2, 0.f);
+        size_t end = std::min(to, phraseEnd);
+        MemoOccurrence const* occ = nullptr;
+        if(pb.nextPhrase > 0 && pb.nextPhrase <= plan.output.size()) {
+            occ = &memo.occurrences[pb.nextPhrase - 1];
+            if(occ->entry < 0) occ = nullptr;
+        }
 
-            for(size_t i = 0; i < maxLen; ++i) {
-                if(i < channel.second.first.size())
-                    outWAV[2 * i + 0] = tanhf(channel.second.first[i]);
-                if(i < channel.second.second.size())
-                    outWAV[2 * i + 1] = tanhf(channel.second.second[i]);
+        // replay a memoized phrase; the state is caught up at its end
+        if(occ && occ->hit) {
+            if(left) {
+                auto&& entry = memo.entries[occ->entry];
+                size_t start = plan.phraseStarts[pb.nextPhrase - 1];
+                if(!played) {
+                    std::fill(left, left + (i - from), 0.f);
+                    std::fill(right, right + (i - from), 0.f);
+                    played = true;
+                }
+                std::copy(&entry.left[i - start], &entry.left[end - start], &left[i - from]);
+                std::copy(&entry.right[i - start], &entry.right[end - start], &right[i - from]);
             }
+            i = end;
+            continue;
+        }
 
-            wav_write_file(fnameBuilder.str(), outWAV, 44100, 2);
+        bool atEvent = false;
+        if(pb.nextEvent < lastEvent && plan.events[pb.nextEvent].offset < end) {
+            end = plan.events[pb.nextEvent].offset;
+            atEvent = true;
         }
-    }
-    else
-    {
-        std::vector<float> left;
-        std::vector<float> right;
-        size_t maxLen = 0;
-        maxLen = std::accumulate(unmixed.begin(), unmixed.end(), maxLen, [](size_t a, decltype(unmixed)::value_type const& b) -> size_t {
-                    return std::max(a, std::max(b.second.first.size(), b.second.second.size()));
-                });
-        left.resize(maxLen);
-        right.resize(maxLen);
-
-        for(auto&& track: unmixed) {
-            for(size_t i = 0; i < track.second.first.size(); ++i) {
-                left[i] += track.second.first[i];
+
+        size_t segment = i;
+        // keep playing whatever was last triggered up until the next event
+        if(i < end && pb.numVoices > 0 && left && !played) {
+            std::fill(left, left + (i - from), 0.f);
+            std::fill(right, right + (i - from), 0.f);
+            played = true;
+        }
+        // when nothing's heard and the effect doesn't care, the voices
+        // only need to move along
+        if(!left && effect.Stateless()) {
+            unsigned alive = 0;
+            for(unsigned v = 0; v < pb.numVoices; ++v) {
+                pb.voices[v].ptr += end - i;
+                if(pb.voices[v].ptr < mydata.size()) pb.voices[alive++] = pb.voices[v];
+            }
+            pb.numVoices = alive;
+            i = end;
+        }
+        while(i < end && pb.numVoices > 0) {
+            // stop at the end of the shortest voice so every voice
+            // covers the whole block
+            size_t n = std::min(end - i, blockSize);
+            for(unsigned v = 0; v < pb.numVoices; ++v) {
+                n = std::min(n, mydata.size() - pb.voices[v].ptr);
+                sources[v] = &mydata[pb.voices[v].ptr];
+                gains[v] = pb.voices[v].gain;
+            }
+            VoiceBlock(sources, gains, pb.numVoices, volume, block, n);
+            if(left) effect(block, &left[i - from], &right[i - from], n);
+            else effect.Skip(block, n);
+            i += n;
+
+            unsigned alive = 0;
+            for(unsigned v = 0; v < pb.numVoices; ++v) {
+                pb.voices[v].ptr += n;
+                if(pb.voices[v].ptr < mydata.size()) pb.voices[alive++] = pb.voices[v];
             }
-            for(size_t i = 0; i < track.second.second.size(); ++i) {
-                right[i] += track.second.second[i];
+            pb.numVoices = alive;
+        }
+        if(played) {
+            std::fill(left + (i - from), left + (end - from), 0.f);
+            std::fill(right + (i - from), right + (end - from), 0.f);
+            // entries start out silent, so only what played is recorded
+            if(occ) {
+                auto&& entry = memo.entries[occ->entry];
+                std::copy(&left[segment - from], &left[end - from], &entry.left[segment - entry.start]);
+                std::copy(&right[segment - from], &right[end - from], &entry.right[segment - entry.start]);
             }
         }
+        i = end;
+
+        if(atEvent) {
+            auto&& e = plan.events[pb.nextEvent++];
+            if(e.stop) {
+                pb.numVoices = 0;
+            } else if(!mydata.empty()) {
+                // steal the oldest voice if they're all busy
+                if(pb.numVoices == track.voices) {
+                    std::copy(pb.voices + 1, pb.voices + pb.numVoices, pb.voices);
+                    --pb.numVoices;
+                }
+                pb.voices[pb.numVoices++] = { 0, e.gain };
+            }
+        }
+    }
+
+    return played;
+}
+
+// e.g. "Skipped 2 unused samples: crash, ride"
+template<typename T>
+static void ReportSkipped(wchar_t const* what, std::vector<T> const& all, std::vector<unsigned> const& ids)
+{
+    if(ids.empty()) return;
+    fwprintf(stderr, L"Skipped %lu unused %ls:", (unsigned long)ids.size(), what);
+    for(size_t i = 0; i < ids.size(); ++i) {
+        fwprintf(stderr, L"%ls %ls", (i ? L"," : L""), all[ids[i]].name.c_str());
+    }
+    fwprintf(stderr, L"\n");
+}
+
+void RenderNew(File const& f, RenderOptions const& options)
+{
+    auto unused = FindUnused(f);
+    ReportSkipped(L"phrases", f.phrases, unused.phrases);
+    ReportSkipped(L"samples", f.samples, unused.samples);
+
+    RenderPlan plan = Compile(f, unused);
+    ThreadPool pool(options.jobs);
+    auto data = LoadData(f, plan, options, pool);
+    size_t numTracks = plan.tracks.size();
+
+    std::vector<SampleData const*> samples(numTracks);
+    for(unsigned t = 0; t < numTracks; ++t) {
+        samples[t] = data[t].get();
+    }
+
+    // one output per track in split mode, then the mix
+    std::vector<std::unique_ptr<Sink>> writers;
+    Player* player = nullptr;
+    if(options.play) {
+        ASSERT(!options.split, L"Can't play split tracks");
+        player = new Player(44100, 2, options.bufferFrames);
+        writers.emplace_back(player);
+    } else if(options.split) {
+        ASSERT(options.filename != L"-", L"Can't write split tracks to stdout");
+        for(auto&& track: plan.tracks) {
+            std::wstringstream fnameBuilder;
+            fnameBuilder << options.filename << L"_" << f.samples[track.sample].name << L".wav";
+            writers.emplace_back(new WavWriter(fnameBuilder.str(), 44100, 2, options.format, options.dither));
+        }
+        writers.emplace_back(new WavWriter(options.filename + L".wav", 44100, 2, options.format, options.dither));
+    } else {
+        writers.emplace_back(new WavWriter(options.filename, 44100, 2, options.format, options.dither));
+    }
+    size_t mixWriter = writers.size() - 1;
+
+    // The song is rendered one window at a time, so memory use only
+    // depends on the window size. A window is cut into one slice per
+    // job and every slice renders and mixes all the tracks on its own.
+    //
+    // A track can be picked up anywhere given its playback and effect
+    // state at that point. lead holds the state of each track at the
+    // start of its last slice; a state-only pass advances it through the
+    // other slices first, leaving a copy at the start of each of them.
+    unsigned numSlices = std::max(options.jobs, 1u);
+    size_t windowFrames = numSlices * sliceFrames;
+    std::vector<float> window(writers.size() * windowFrames * 2);
+    std::vector<float> scratch(numSlices * numTracks * 2 * mixFrames);
+    std::vector<std::vector<float const*>> mixLefts(numSlices), mixRights(numSlices);
+    for(unsigned s = 0; s < numSlices; ++s) {
+        mixLefts[s].reserve(numTracks);
+        mixRights[s].reserve(numTracks);
+    }
 
-        std::for_each(left.begin(), left.end(), [](float& f) { f = tanhf(f); });
-        std::for_each(right.begin(), right.end(), [](float& f) { f = tanhf(f); });
+    // phrases which show up again later in the song are worth keeping
+    std::vector<bool> repeats(plan.output.size(), false);
+    std::vector<bool> seen(plan.numPhrases, false);
+    std::vector<bool> repeating(plan.numPhrases, false);
+    for(size_t k = plan.output.size(); k-- > 0;) {
+        repeats[k] = seen[plan.output[k]];
+        seen[plan.output[k]] = true;
+        if(repeats[k]) repeating[plan.output[k]] = true;
+    }
+    size_t memoEntries = memoEntriesPerPhrase * (size_t)std::count(repeating.begin(), repeating.end(), true);
+    // the slots are paid for up front, the recordings as they're made
+    std::atomic<long long> budget(memoBudget - (long long)(numTracks * memoEntries * sizeof(MemoEntry)));
+    std::vector<TrackMemo> memos(numTracks);
+    for(auto&& memo: memos) {
+        memo.entries.resize(memoEntries);
+        memo.occurrences.resize(plan.output.size());
+        memo.repeats = &repeats;
+        memo.budget = &budget;
+    }
 
-        while(left.size() < right.size()) left.emplace_back();
-        while(right.size() < left.size()) right.emplace_back();
+    std::vector<Playback> lead(numTracks);
+    std::vector<StereoInstance*> leadEffect(numTracks);
+    std::vector<Playback> starts(numTracks * numSlices);
+    std::vector<std::unique_ptr<StereoInstance>> startEffects(numTracks * numSlices);
+    for(unsigned t = 0; t < numTracks; ++t) {
+        lead[t].numVoices = 0;
+        lead[t].nextEvent = plan.tracks[t].firstEvent;
+        lead[t].nextPhrase = 0;
+        leadEffect[t] = &plan.tracks[t].effect->Instance();
+    }
 
-        std::vector<float> outWAV;
+    for(size_t w = 0; w < plan.length; w += windowFrames) {
+        size_t windowEnd = std::min(w + windowFrames, plan.length);
+        size_t slices = (windowEnd - w + sliceFrames - 1) / sliceFrames;
+
+        ParallelFor(pool, numTracks, [&](size_t t) {
+            for(size_t s = 0; s + 1 < slices; ++s) {
+                auto&& effect = startEffects[t * numSlices + s];
+                if(effect) effect->Restore(*leadEffect[t]);
+                else effect.reset(leadEffect[t]->Snapshot());
+                starts[t * numSlices + s] = lead[t];
+
+                size_t from = w + s * sliceFrames;
+                RenderTrack(plan, (unsigned)t, *samples[t], lead[t], *leadEffect[t], memos[t], true, w, from, from + sliceFrames, nullptr, nullptr);
+            }
+        });
 
-        for(size_t i = 0; i < left.size(); ++i) {
-            outWAV.push_back(left[i]);
-            outWAV.push_back(right[i]);
+        ParallelFor(pool, slices, [&](size_t s) {
+            size_t from = w + s * sliceFrames;
+            size_t to = std::min(from + sliceFrames, windowEnd);
+            float* trackBuffers = &scratch[s * numTracks * 2 * mixFrames];
+            auto&& lefts = mixLefts[s];
+            auto&& rights = mixRights[s];
+
+            for(size_t i = from; i < to; i += mixFrames) {
+                size_t n = std::min(mixFrames, to - i);
+                lefts.clear();
+                rights.clear();
+
+                for(unsigned t = 0; t < numTracks; ++t) {
+                    bool last = (s + 1 == slices);
+                    auto&& pb = last ? lead[t] : starts[t * numSlices + s];
+                    auto&& effect = last ? *leadEffect[t] : *startEffects[t * numSlices + s];
+                    float* left = trackBuffers + (2 * t + 0) * mixFrames;
+                    float* right = trackBuffers + (2 * t + 1) * mixFrames;
+                    bool played = RenderTrack(plan, t, *samples[t], pb, effect, memos[t], last, w, i, i + n, left, right);
+
+                    if(options.split) {
+                        float* out = &window[(t * windowFrames + i - w) * 2];
+                        if(played) ClipBlock(left, right, out, n, options.softClip);
+                        else std::fill(out, out + 2 * n, 0.f);
+                    }
+                    if(played) {
+                        lefts.push_back(left);
+                        rights.push_back(right);
+                    }
+                }
+
+                MixBlock(lefts.data(), rights.data(), lefts.size(), &window[(mixWriter * windowFrames + i - w) * 2], n, options.softClip);
+            }
+        });
+
+        // a worker thread can't throw, so the first failure is passed
+        // back to this one
+        std::vector<std::exception_ptr> errors(writers.size());
+        ParallelFor(pool, writers.size(), [&](size_t b) {
+            try {
+                writers[b]->Write(&window[b * windowFrames * 2], windowEnd - w);
+            } catch(...) {
+                errors[b] = std::current_exception();
+            }
+        });
+        for(auto&& error: errors) {
+            if(error) std::rethrow_exception(error);
         }
+    }
+
+    for(auto&& writer: writers) {
+        writer->Close();
+    }
+
+    if(player) {
+        fwprintf(stderr, L"Playback finished with %lu underruns\n", (unsigned long)player->Underruns());
+    }
 
-        wav_write_file(filename, outWAV, 44100, 2);
+    if(options.stats) {
+        size_t lookups = 0, hits = 0;
+        for(auto&& memo: memos) {
+            lookups += memo.lookups;
+            hits += memo.hits;
+        }
+        fwprintf(stderr, L"Memoized %lu of %lu phrase renders (%.1f%%)\n",
+                (unsigned long)hits,
+                (unsigned long)lookups,
+                lookups ? 100.0 * hits / lookups : 0.0);
     }
 }
 
-void RenderOld(File f, std::wstring filename, bool split)
+void RenderOld(File const& f, RenderOptions const& options)
 {
-    ASSERT(split == false, L"Split mode not supported in old renderer");
-    auto&& data = LoadData(f);
+    auto&& filename = options.filename;
+    ASSERT(options.split == false, L"Split mode not supported in old renderer");
+    // nothing is skipped, so track t plays sample t
+    ThreadPool pool(options.jobs);
+    auto&& data = LoadData(f, Compile(f, UnusedAssets()), options, pool);
     std::vector<float> outWAV;
 
-    for(auto&& name: f.output) {
-        auto&& phrase = f.phrases[name];
+    for(unsigned id: f.output) {
+        auto&& phrase = f.phrases[id];
         size_t numSamplesPerBeat = 44100 * 60 / (phrase.bpm);
-        size_t maxLen = std::accumulate(
-                phrase.beats.begin(), phrase.beats.end(), (size_t)0,
-                [](size_t a, decltype(phrase.beats)::value_type b) -> size_t {
-                    return std::max(a, b.second.size());
-                }
-                );
-        for(size_t i = 0; i < maxLen; ++i) {
+        for(size_t i = 0; i < phrase.length; ++i) {
             std::vector<float> ff(numSamplesPerBeat, 0.f);
-            for(auto& beat: phrase.beats) {
-                if(beat.second.size() <= i) continue;
-
-                if(beat.second[i] == File::Beat::REST) continue;
+            for(size_t row = 0; row < phrase.samples.size(); ++row) {
+                auto beat = phrase.At(row, i);
+                if(beat == File::Beat::REST) continue;
                 float gain = 1.f;
-                if(beat.second[i] == File::Beat::HALF) gain = 0.5f;
-                auto&& mydata = data[beat.first];
+                if(beat == File::Beat::HALF) gain = 0.5f;
+                auto&& mydata = *data[phrase.samples[row]];
                 size_t sampSize = mydata.size();
                 size_t toCopy = std::min(sampSize, numSamplesPerBeat);
-                auto volume = (float)f.samples[beat.first].volume / 100.f;
+                auto volume = (float)f.samples[phrase.samples[row]].volume / 100.f;
 		for (size_t i = 0; i < toCopy; ++i) {
 			ff[i] += gain * mydata[i] * volume;
 		}
             }
-            std::for_each(ff.begin(), ff.end(), [](float& f) {
-                        f = tanhf(f);
-                    });
+            SoftClipBlock(options.softClip, ff.data(), ff.size());
             std::copy(ff.begin(), ff.end(), std::back_inserter(outWAV));
         }
     }
 
-    extern void wav_write_file(std::wstring const&, std::vector<float> const&, unsigned, unsigned);
     wav_write_file(filename, outWAV, 44100, 1);
 }
@@ -0,0 +1,52 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <string>
+#include <file.h>
+#include <softclip.h>
+#include <resample.h>
+#include <pcm.h>
+
+struct RenderOptions
+{
+    std::wstring filename = L"test.wav";
+    bool split = false; // write one file per track instead of mixing
+    PcmFormat format = PcmFormat::F32; // of the samples written out
+    bool dither = false; // dither integer output
+    unsigned jobs = 1; // worker threads
+    SoftClip softClip = SoftClip::EXACT;
+    ResampleQuality resampleQuality = ResampleQuality::MEDIUM; // for samples not at 44100Hz
+    std::wstring cacheDir; // where decoded samples are cached; empty for no cache
+    bool stats = false; // print render statistics to stderr
+    bool play = false; // play through the sound card instead of writing a file
+    size_t bufferFrames = 16384; // size of the playback buffer
+};
+
+void Render(File const& f, RenderOptions const& options);
+
+#endif
@@ -0,0 +1,304 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <resample.h>
+#include <simd.h>
+#include <errorassert.h>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+namespace {
+    // Resampling by up/down uses `up' filters, one for every fractional
+    // position an output sample can fall on between two input samples.
+    struct FilterBank
+    {
+        unsigned up, down;
+        size_t taps; // per filter; a multiple of 8 so the kernels have no tails
+        size_t half; // taps before and including the input sample at or before the output
+        std::vector<float> coefs; // up * taps
+    };
+
+    struct QualityParams
+    {
+        double zeroCrossings; // on either side
+        double beta;
+        double passband;
+    };
+}
+
+static QualityParams GetQualityParams(ResampleQuality quality)
+{
+    switch(quality) {
+    case ResampleQuality::FAST: return { 4, 5, 0.85 };
+    case ResampleQuality::MEDIUM: return { 16, 7, 0.92 };
+    case ResampleQuality::BEST: break;
+    }
+    return { 32, 9.5, 0.95 };
+}
+
+bool ParseResampleQuality(std::wstring const& name, ResampleQuality& quality)
+{
+    if(name == L"fast") quality = ResampleQuality::FAST;
+    else if(name == L"medium") quality = ResampleQuality::MEDIUM;
+    else if(name == L"best") quality = ResampleQuality::BEST;
+    else return false;
+    return true;
+}
+
+std::vector<float> Downmix(float const* samples, size_t numFrames, unsigned numChannels)
+{
+    if(numChannels == 1) return std::vector<float>(samples, samples + numFrames);
+
+    std::vector<float> rval(numFrames);
+    float scale = 1.f / numChannels;
+    for(size_t i = 0; i < numFrames; ++i) {
+        float sum = 0.f;
+        for(unsigned c = 0; c < numChannels; ++c) {
+            sum += samples[i * numChannels + c];
+        }
+        rval[i] = sum * scale;
+    }
+    return rval;
+}
+
+// modified Bessel function of the first kind, order 0
+static double BesselI0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    for(int k = 1; k < 64 && term > sum * 1e-12; ++k) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+static std::unique_ptr<FilterBank> DesignFilterBank(unsigned up, unsigned down, ResampleQuality quality)
+{
+    const double pi = 3.14159265358979323846;
+    auto params = GetQualityParams(quality);
+
+    std::unique_ptr<FilterBank> bank(new FilterBank);
+    bank->up = up;
+    bank->down = down;
+    // cutoff in cycles per input sample, times two
+    double cutoff = std::min(1.0, (double)up / down) * params.passband;
+    size_t half = (size_t)std::ceil(params.zeroCrossings / cutoff);
+    bank->half = (half + 3) / 4 * 4;
+    bank->taps = 2 * bank->half;
+    bank->coefs.resize(up * bank->taps);
+
+    double i0beta = BesselI0(params.beta);
+    for(unsigned p = 0; p < up; ++p) {
+        float* filter = &bank->coefs[p * bank->taps];
+        double sum = 0.0;
+        for(size_t j = 0; j < bank->taps; ++j) {
+            // distance from the output sample to the input sample under tap j
+            double t = (double)j - (double)bank->half + 1.0 - (double)p / up;
+            double x = t / bank->half;
+            double window = (std::fabs(x) < 1.0) ? BesselI0(params.beta * std::sqrt(1.0 - x * x)) / i0beta : 0.0;
+            double sinc = (t == 0.0) ? 1.0 : std::sin(pi * cutoff * t) / (pi * cutoff * t);
+            double h = cutoff * sinc * window;
+            filter[j] = (float)h;
+            sum += h;
+        }
+        // exactly unity gain at DC for every phase
+        for(size_t j = 0; j < bank->taps; ++j) {
+            filter[j] = (float)(filter[j] / sum);
+        }
+    }
+
+    return bank;
+}
+
+// Filter banks only depend on the ratio and the quality, and are shared
+// by every sample converted the same way.
+static FilterBank const& GetFilterBank(unsigned up, unsigned down, ResampleQuality quality)
+{
+    static std::mutex mutex;
+    static std::map<std::tuple<unsigned, unsigned, ResampleQuality>, std::unique_ptr<FilterBank>> banks;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto&& bank = banks[std::make_tuple(up, down, quality)];
+    if(!bank) bank = DesignFilterBank(up, down, quality);
+    return *bank;
+}
+
+// Output sample k sits at input position k * down / up; in[] is padded
+// with half zeros on either side so the filters can run off the ends.
+static void ConvolveScalar(FilterBank const& bank, float const* in, float* out, size_t n)
+{
+    size_t base = 0, phase = 0;
+    size_t step = bank.down / bank.up, rem = bank.down % bank.up;
+    for(size_t k = 0; k < n; ++k) {
+        float const* x = in + base;
+        float const* h = &bank.coefs[phase * bank.taps];
+        float sum = 0.f;
+        for(size_t j = 0; j < bank.taps; ++j) {
+            sum += x[j] * h[j];
+        }
+        out[k] = sum;
+
+        base += step;
+        phase += rem;
+        if(phase >= bank.up) {
+            phase -= bank.up;
+            ++base;
+        }
+    }
+}
+
+SIMD_TARGET_SSE41
+static void ConvolveSse41(FilterBank const& bank, float const* in, float* out, size_t n)
+{
+    size_t base = 0, phase = 0;
+    size_t step = bank.down / bank.up, rem = bank.down % bank.up;
+    for(size_t k = 0; k < n; ++k) {
+        float const* x = in + base;
+        float const* h = &bank.coefs[phase * bank.taps];
+        __m128 sum0 = _mm_setzero_ps();
+        __m128 sum1 = _mm_setzero_ps();
+        for(size_t j = 0; j < bank.taps; j += 8) {
+            sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(x + j), _mm_loadu_ps(h + j)));
+            sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(x + j + 4), _mm_loadu_ps(h + j + 4)));
+        }
+        __m128 sum = _mm_add_ps(sum0, sum1);
+        sum = _mm_hadd_ps(sum, sum);
+        sum = _mm_hadd_ps(sum, sum);
+        out[k] = _mm_cvtss_f32(sum);
+
+        base += step;
+        phase += rem;
+        if(phase >= bank.up) {
+            phase -= bank.up;
+            ++base;
+        }
+    }
+}
+
+SIMD_TARGET_AVX2
+static void ConvolveAvx2(FilterBank const& bank, float const* in, float* out, size_t n)
+{
+    size_t base = 0, phase = 0;
+    size_t step = bank.down / bank.up, rem = bank.down % bank.up;
+    for(size_t k = 0; k < n; ++k) {
+        float const* x = in + base;
+        float const* h = &bank.coefs[phase * bank.taps];
+        __m256 sum = _mm256_setzero_ps();
+        for(size_t j = 0; j < bank.taps; j += 8) {
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(x + j), _mm256_loadu_ps(h + j)));
+        }
+        __m128 sum4 = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+        sum4 = _mm_hadd_ps(sum4, sum4);
+        sum4 = _mm_hadd_ps(sum4, sum4);
+        out[k] = _mm_cvtss_f32(sum4);
+
+        base += step;
+        phase += rem;
+        if(phase >= bank.up) {
+            phase -= bank.up;
+            ++base;
+        }
+    }
+}
+
+static const bool hasAvx2 = CpuHasAvx2();
+static const bool hasSse41 = CpuHasSse41();
+
+static unsigned Gcd(unsigned a, unsigned b)
+{
+    while(b) {
+        unsigned t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+std::vector<float> Resample(float const* samples, size_t n, unsigned fromRate, unsigned toRate, ResampleQuality quality)
+{
+    ASSERT(fromRate > 0 && toRate > 0, L"Invalid sample rate");
+    if(fromRate == toRate) return std::vector<float>(samples, samples + n);
+
+    unsigned gcd = Gcd(fromRate, toRate);
+    auto&& bank = GetFilterBank(toRate / gcd, fromRate / gcd, quality);
+
+    std::vector<float> padded(bank.half + n + bank.half, 0.f);
+    std::copy(samples, samples + n, padded.begin() + bank.half);
+
+    size_t length = (size_t)(((unsigned long long)n * bank.up + bank.down - 1) / bank.down);
+    std::vector<float> rval(length);
+    // the first tap of output 0 is half - 1 samples before input 0
+    float const* in = padded.data() + 1;
+    if(hasAvx2) ConvolveAvx2(bank, in, rval.data(), length);
+    else if(hasSse41) ConvolveSse41(bank, in, rval.data(), length);
+    else ConvolveScalar(bank, in, rval.data(), length);
+    return rval;
+}
+
+#ifdef BENCH_RESAMPLE
+#include <chrono>
+#include <cstdio>
+int main()
+{
+    const double pi = 3.14159265358979323846;
+    const unsigned fromRate = 48000, toRate = 44100;
+    const size_t n = 10 * fromRate;
+
+    printf("%s, %u Hz to %u Hz\n", hasAvx2 ? "avx2" : hasSse41 ? "sse4.1" : "scalar", fromRate, toRate);
+    for(auto quality: { ResampleQuality::FAST, ResampleQuality::MEDIUM, ResampleQuality::BEST }) {
+        char const* name = (quality == ResampleQuality::FAST) ? "fast" : (quality == ResampleQuality::MEDIUM) ? "medium" : "best";
+        GetFilterBank(147, 160, quality);
+
+        // error against the ideal result for tones well inside the
+        // passband, and what's left of one above the output's Nyquist
+        for(double freq: { 1000.0, 10000.0, 18000.0, 23000.0 }) {
+            std::vector<float> in(n);
+            for(size_t i = 0; i < n; ++i) in[i] = (float)(0.5 * std::sin(2 * pi * freq * i / fromRate));
+
+            auto start = std::chrono::steady_clock::now();
+            auto out = Resample(in.data(), n, fromRate, toRate, quality);
+            auto end = std::chrono::steady_clock::now();
+
+            double maxError = 0.0, maxLevel = 0.0;
+            for(size_t k = toRate / 10; k + toRate / 10 < out.size(); ++k) {
+                double ideal = (freq < toRate / 2) ? 0.5 * std::sin(2 * pi * freq * k / toRate) : 0.0;
+                maxError = std::max(maxError, std::fabs(out[k] - ideal));
+                maxLevel = std::max(maxLevel, (double)std::fabs(out[k]));
+            }
+            if(freq < toRate / 2) {
+                printf("%-7s %5.0f Hz  max error %.2g  %6.1f ns/sample\n", name, freq, maxError,
+                        std::chrono::duration<double, std::nano>(end - start).count() / out.size());
+            } else {
+                printf("%-7s %5.0f Hz  leaks through at %.1f dB\n", name, freq, 20 * std::log10(maxLevel / 0.5 + 1e-12));
+            }
+        }
+    }
+}
+#endif
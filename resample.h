@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// How carefully samples are converted to the output rate. All of them
+// are polyphase Kaiser windowed sinc filters; converting sines from
+// 48kHz to 44.1kHz (see bench_resample in Makefile.gcc) gives:
+//
+//            taps  max error at 1k / 10k / 18kHz   23kHz leaks through at   ns/sample
+//   FAST       16  5.4e-4 / 1.2e-3 / 0.18          -38dB                    6.2
+//   MEDIUM     40  7.4e-5 / 4.7e-5 / 2.8e-3        -73dB                    8.0
+//   BEST       80  9.5e-7 / 4.1e-6 / 6.7e-6        -98dB                    9.7
+//
+// The filters are vectorised, and the timings are the best of several
+// runs on an AVX2 machine. Five times the taps only costs BEST about 1.6
+// times the time of FAST, since padding the input and allocating the
+// output cost about as much as the shorter filters do.
+enum class ResampleQuality
+{
+    FAST,
+    MEDIUM,
+    BEST
+};
+
+// parses the name of a resampler quality as given on the command line
+bool ParseResampleQuality(std::wstring const& name, ResampleQuality& quality);
+
+// averages the channels of numFrames interleaved frames
+std::vector<float> Downmix(float const* samples, size_t numFrames, unsigned numChannels);
+
+// Converts n mono samples from fromRate to toRate. The result only
+// depends on the arguments, so it can be cached by them.
+std::vector<float> Resample(float const* samples, size_t n, unsigned fromRate, unsigned toRate, ResampleQuality quality);
+
+#endif
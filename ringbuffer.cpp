@@ -0,0 +1,76 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <ringbuffer.h>
+#include <algorithm>
+
+static size_t RoundUpToPowerOfTwo(size_t n)
+{
+    size_t rval = 1;
+    while(rval < n) rval <<= 1;
+    return rval;
+}
+
+RingBuffer::RingBuffer(size_t minCapacity)
+    : buffer(RoundUpToPowerOfTwo(std::max(minCapacity, (size_t)1)))
+    , mask(buffer.size() - 1)
+    , head(0)
+    , tail(0)
+{}
+
+size_t RingBuffer::Write(float const* data, size_t n)
+{
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t t = tail.load(std::memory_order_acquire);
+    n = std::min(n, buffer.size() - (h - t));
+
+    // in at most two pieces, around the end of the buffer
+    size_t first = std::min(n, buffer.size() - (h & mask));
+    std::copy(data, data + first, &buffer[h & mask]);
+    std::copy(data + first, data + n, &buffer[0]);
+
+    head.store(h + n, std::memory_order_release);
+    return n;
+}
+
+size_t RingBuffer::Read(float* data, size_t n)
+{
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    n = std::min(n, h - t);
+
+    size_t first = std::min(n, buffer.size() - (t & mask));
+    std::copy(&buffer[t & mask], &buffer[t & mask] + first, data);
+    std::copy(&buffer[0], &buffer[0] + (n - first), data + first);
+
+    tail.store(t + n, std::memory_order_release);
+    return n;
+}
+
+size_t RingBuffer::Available() const
+{
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+}
@@ -0,0 +1,259 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <sample.h>
+#include <errorassert.h>
+#include <string_utils.h>
+#include <wavreader.h>
+#include <pcm.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <atomic>
+
+#ifdef _MSC_VER
+# define WIN32_LEAN_AND_MEAN
+# define VC_EXTRALEAN
+# include <windows.h>
+# include <direct.h>
+# include <process.h>
+#else
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+// bump this whenever decoding changes what ends up in the cache
+static const uint32_t cacheVersion = 1;
+
+namespace {
+    // what cache files start with; followed by the samples
+    struct CacheHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t numSamples;
+    };
+}
+
+SampleData::SampleData(std::vector<float>&& decoded_)
+    : samples(nullptr)
+    , numSamples(decoded_.size())
+    , decoded(std::move(decoded_))
+{
+    samples = decoded.data();
+}
+
+SampleData::SampleData(std::unique_ptr<MappedFile>&& mapping_, size_t offset, size_t numSamples_)
+    : samples((float const*)(mapping_->Data() + offset))
+    , numSamples(numSamples_)
+    , mapping(std::move(mapping_))
+{}
+
+static uint64_t Rotl(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+// 64bit hash along the lines of xxHash64; four independent lanes eat 32
+// bytes at a time, so hashing keeps up with reading the file
+static uint64_t HashBytes(uint8_t const* p, size_t n)
+{
+    const uint64_t p1 = 11400714785074694791ull;
+    const uint64_t p2 = 14029467366897019727ull;
+    const uint64_t p3 = 1609587929392839161ull;
+    const uint64_t p4 = 9650029242287828579ull;
+    const uint64_t p5 = 2870177450012600261ull;
+
+    auto mix = [&](uint64_t acc, uint64_t x) {
+        return Rotl(acc + x * p2, 31) * p1;
+    };
+    auto read64 = [](uint8_t const* q) {
+        uint64_t x;
+        memcpy(&x, q, sizeof(x));
+        return x;
+    };
+
+    uint64_t h;
+    size_t i = 0;
+    if(n >= 32) {
+        uint64_t v[4] = { p1 + p2, p2, 0, 0 - p1 };
+        for(; i + 32 <= n; i += 32) {
+            for(int k = 0; k < 4; ++k) v[k] = mix(v[k], read64(p + i + 8 * k));
+        }
+        h = Rotl(v[0], 1) + Rotl(v[1], 7) + Rotl(v[2], 12) + Rotl(v[3], 18);
+        for(int k = 0; k < 4; ++k) h = (h ^ mix(0, v[k])) * p1 + p4;
+    } else {
+        h = p5;
+    }
+    h += n;
+
+    for(; i + 8 <= n; i += 8) h = Rotl(h ^ mix(0, read64(p + i)), 27) * p1 + p4;
+    for(; i < n; ++i) h = Rotl(h ^ (p[i] * p5), 11) * p1;
+
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+static PcmFormat GetPcmFormat(WavInfo const& info)
+{
+    if(info.encoding == WavInfo::Encoding::FLOAT) {
+        switch(info.bitsPerSample) {
+        case 32: return PcmFormat::F32;
+        case 64: return PcmFormat::F64;
+        }
+    } else {
+        switch(info.bitsPerSample) {
+        case 8: return PcmFormat::U8;
+        case 16: return PcmFormat::S16;
+        case 24: return PcmFormat::S24;
+        case 32: return PcmFormat::S32;
+        }
+    }
+    throw std::runtime_error("expecting 8, 16, 24 or 32bit integer or 32 or 64bit float samples; got "
+            + std::to_string(info.bitsPerSample) + "bit "
+            + ((info.encoding == WavInfo::Encoding::FLOAT) ? "float" : "integer"));
+}
+
+// Decodes the wave file in file. Mono float samples at 44100Hz are used
+// right where they are in the mapping; everything else is converted.
+static std::shared_ptr<SampleData const> Decode(std::unique_ptr<MappedFile>&& file, ResampleQuality quality, bool& inPlace)
+{
+    auto info = ParseWav(file->Data(), file->Size());
+    uint8_t const* data = file->Data() + info.dataOffset;
+    size_t numSamples = info.numFrames * info.numChannels;
+    bool isFloat = (info.encoding == WavInfo::Encoding::FLOAT && info.bitsPerSample == 32);
+
+    inPlace = isFloat && info.numChannels == 1 && info.samplesPerSecond == 44100
+        && info.dataOffset % alignof(float) == 0;
+    if(inPlace) {
+        return std::make_shared<SampleData>(std::move(file), info.dataOffset, info.numFrames);
+    }
+
+    std::vector<float> wav(numSamples);
+    PcmToFloat(GetPcmFormat(info), data, wav.data(), numSamples);
+
+    // everything's mixed as mono at 44100Hz
+    if(info.numChannels > 1) {
+        wav = Downmix(wav.data(), info.numFrames, info.numChannels);
+    }
+    if(info.samplesPerSecond != 44100) {
+        wav = Resample(wav.data(), wav.size(), info.samplesPerSecond, 44100, quality);
+    }
+    return std::make_shared<SampleData>(std::move(wav));
+}
+
+static std::shared_ptr<SampleData const> ReadCache(std::wstring const& cachePath)
+{
+    std::unique_ptr<MappedFile> mapping(new MappedFile(cachePath));
+    if(!mapping->IsOpen() || mapping->Size() < sizeof(CacheHeader)) return nullptr;
+
+    // a damaged entry is decoded again, which rewrites it; numSamples is
+    // bounded first so the size computation can't wrap around
+    CacheHeader header;
+    memcpy(&header, mapping->Data(), sizeof(header));
+    if(memcmp(header.magic, "JKBC", 4) != 0
+            || header.version != cacheVersion
+            || header.numSamples > (mapping->Size() - sizeof(CacheHeader)) / sizeof(float)
+            || mapping->Size() != sizeof(CacheHeader) + header.numSamples * sizeof(float))
+    {
+        return nullptr;
+    }
+
+    return std::make_shared<SampleData>(std::move(mapping), sizeof(CacheHeader), (size_t)header.numSamples);
+}
+
+// Writes to a temporary file first and renames it into place, so other
+// processes only ever see whole cache files. Failing to write the cache
+// only costs the next run some time, so it's not an error.
+static void WriteCache(std::wstring const& cacheDir, std::wstring const& cachePath, SampleData const& samples)
+{
+    // unique across processes and across the threads loading samples
+    static std::atomic<unsigned> counter(0);
+#ifdef _MSC_VER
+    _wmkdir(cacheDir.c_str());
+    std::wstringstream tmpBuilder;
+    tmpBuilder << cachePath << L".tmp" << _getpid() << L"." << counter++;
+#else
+    mkdir(W2MB(cacheDir).get(), 0777);
+    std::wstringstream tmpBuilder;
+    tmpBuilder << cachePath << L".tmp" << getpid() << L"." << counter++;
+#endif
+    auto tmpPath = tmpBuilder.str();
+
+    FILE* f = open_write_binary(tmpPath.c_str());
+    if(!f) return;
+    CacheHeader header = { { 'J', 'K', 'B', 'C' }, cacheVersion, samples.size() };
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && fwrite(samples.data(), sizeof(float), samples.size(), f) == samples.size();
+    ok = (fclose(f) == 0) && ok;
+
+#ifdef _MSC_VER
+    ok = ok && MoveFileExW(tmpPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING);
+    if(!ok) _wremove(tmpPath.c_str());
+#else
+    ok = ok && rename(W2MB(tmpPath).get(), W2MB(cachePath).get()) == 0;
+    if(!ok) remove(W2MB(tmpPath).get());
+#endif
+}
+
+std::shared_ptr<SampleData const> LoadSample(std::wstring const& path, ResampleQuality quality, std::wstring const& cacheDir, bool* fromCache)
+{
+    if(fromCache) *fromCache = false;
+    std::unique_ptr<MappedFile> file(new MappedFile(path));
+    if(!file->IsOpen()) throw std::runtime_error("can't open file");
+
+    bool inPlace = false;
+    if(cacheDir.empty()) {
+        return Decode(std::move(file), quality, inPlace);
+    }
+
+    // the key covers everything that goes into the decoded data
+    std::wstringstream keyBuilder;
+    keyBuilder << cacheDir << L"/"
+        << std::hex << std::setfill(L'0') << std::setw(16) << HashBytes(file->Data(), file->Size())
+        << std::dec << L"-" << file->Size()
+        << L"-q" << (int)quality
+        << L"-v" << cacheVersion
+        << L".f32";
+    auto cachePath = keyBuilder.str();
+
+    auto cached = ReadCache(cachePath);
+    if(cached) {
+        if(fromCache) *fromCache = true;
+        return cached;
+    }
+
+    auto decoded = Decode(std::move(file), quality, inPlace);
+    // no point in caching what's already usable as is
+    if(!inPlace) WriteCache(cacheDir, cachePath, *decoded);
+    return decoded;
+}
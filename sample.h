@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SAMPLE_H
+#define SAMPLE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <resample.h>
+#include <mappedfile.h>
+
+// A sample decoded to mono floats at 44100Hz, either in memory or mapped
+// straight out of the cache.
+struct SampleData
+{
+    explicit SampleData(std::vector<float>&& decoded);
+    SampleData(std::unique_ptr<MappedFile>&& mapping, size_t offset, size_t numSamples);
+
+    float const* data() const { return samples; }
+    size_t size() const { return numSamples; }
+    bool empty() const { return numSamples == 0; }
+    float const& operator[](size_t i) const { return samples[i]; }
+
+private:
+    float const* samples;
+    size_t numSamples;
+    std::vector<float> decoded;
+    std::unique_ptr<MappedFile> mapping;
+
+    SampleData(SampleData const&) = delete;
+    SampleData& operator=(SampleData const&) = delete;
+};
+
+// Loads the wave file at path. If cacheDir isn't empty, the decoded data
+// is looked up there first by the hash of the file and the way it's
+// decoded, and stored there after decoding it otherwise; fromCache says
+// which. Throws std::runtime_error if the file can't be loaded.
+std::shared_ptr<SampleData const> LoadSample(std::wstring const& path, ResampleQuality quality, std::wstring const& cacheDir, bool* fromCache = nullptr);
+
+#endif
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SIMD_H
+#define SIMD_H
+
+// Helpers for picking a code path at run time. The build itself only
+// assumes SSE2; anything wider is compiled per function and only called
+// after checking that the CPU supports it.
+
+#include <cstdint>
+
+#if defined(__GNUC__)
+# include <x86intrin.h>
+# define SIMD_TARGET(X) __attribute__((target(X)))
+#elif defined(_MSC_VER)
+# include <intrin.h>
+# include <immintrin.h>
+# define SIMD_TARGET(X)
+#endif
+
+// index of the lowest set bit; x can't be 0
+inline unsigned CountTrailingZeros(uint64_t x)
+{
+#if defined(__GNUC__)
+    return (unsigned)__builtin_ctzll(x);
+#elif defined(_M_X64)
+    unsigned long index;
+    _BitScanForward64(&index, x);
+    return (unsigned)index;
+#else
+    unsigned long index;
+    if(_BitScanForward(&index, (unsigned long)x)) return (unsigned)index;
+    _BitScanForward(&index, (unsigned long)(x >> 32));
+    return (unsigned)index + 32;
+#endif
+}
+
+#define SIMD_TARGET_SSE41 SIMD_TARGET("sse4.1")
+#define SIMD_TARGET_AVX2 SIMD_TARGET("avx2")
+
+inline bool CpuHasSse41()
+{
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("sse4.1");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 19)) != 0;
+#endif
+}
+
+inline bool CpuHasAvx2()
+{
+#if defined(__GNUC__)
+    return __builtin_cpu_supports("avx2");
+#else
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if(!osxsave || !avx) return false;
+    if((_xgetbv(0) & 6) != 6) return false; // OS saves the ymm registers
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+#endif
@@ -0,0 +1,279 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#include <softclip.h>
+#include <simd.h>
+#include <cmath>
+#include <cstdint>
+
+bool ParseSoftClip(std::wstring const& name, SoftClip& clip)
+{
+    if(name == L"exact") clip = SoftClip::EXACT;
+    else if(name == L"rational") clip = SoftClip::RATIONAL;
+    else if(name == L"table") clip = SoftClip::TABLE;
+    else return false;
+    return true;
+}
+
+static void ExactScalar(float* samples, size_t i, size_t n)
+{
+    for(; i < n; ++i) samples[i] = tanhf(samples[i]);
+}
+
+// tanh(x) ~= x * P(x^2) / Q(x^2); beyond the clamp the result rounds to
+// +/-1 anyway, and close to 0 x itself is more accurate
+static const float rationalClamp = 7.90531110763549805f;
+static const float rationalLinear = 0.0004f;
+static const float alpha[] = {
+    4.89352455891786e-03f,
+    6.37261928875436e-04f,
+    1.48572235717979e-05f,
+    5.12229709037114e-08f,
+    -8.60467152213735e-11f,
+    2.00018790482477e-13f,
+    -2.76076847742355e-16f,
+};
+static const float beta[] = {
+    4.89352518554385e-03f,
+    2.26843463243900e-03f,
+    1.18534705686654e-04f,
+    1.19825839466702e-06f,
+};
+
+static void RationalScalar(float* samples, size_t i, size_t n)
+{
+    for(; i < n; ++i) {
+        float x = samples[i];
+        if(fabsf(x) < rationalLinear) continue;
+        x = fminf(fmaxf(x, -rationalClamp), rationalClamp);
+        float x2 = x * x;
+        float p = alpha[6];
+        for(int k = 5; k >= 0; --k) p = p * x2 + alpha[k];
+        float q = beta[3];
+        for(int k = 2; k >= 0; --k) q = q * x2 + beta[k];
+        samples[i] = x * p / q;
+    }
+}
+
+SIMD_TARGET_SSE41
+static void RationalSse41(float* samples, size_t n)
+{
+    const __m128 clamp = _mm_set1_ps(rationalClamp);
+    const __m128 linear = _mm_set1_ps(rationalLinear);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 in = _mm_loadu_ps(samples + i);
+        __m128 x = _mm_min_ps(_mm_max_ps(in, _mm_sub_ps(_mm_setzero_ps(), clamp)), clamp);
+        __m128 x2 = _mm_mul_ps(x, x);
+        __m128 p = _mm_set1_ps(alpha[6]);
+        for(int k = 5; k >= 0; --k) p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(alpha[k]));
+        __m128 q = _mm_set1_ps(beta[3]);
+        for(int k = 2; k >= 0; --k) q = _mm_add_ps(_mm_mul_ps(q, x2), _mm_set1_ps(beta[k]));
+        __m128 y = _mm_div_ps(_mm_mul_ps(x, p), q);
+        __m128 small = _mm_cmplt_ps(_mm_and_ps(in, absMask), linear);
+        _mm_storeu_ps(samples + i, _mm_blendv_ps(y, in, small));
+    }
+    RationalScalar(samples, i, n);
+}
+
+SIMD_TARGET_AVX2
+static void RationalAvx2(float* samples, size_t n)
+{
+    const __m256 clamp = _mm256_set1_ps(rationalClamp);
+    const __m256 linear = _mm256_set1_ps(rationalLinear);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 in = _mm256_loadu_ps(samples + i);
+        __m256 x = _mm256_min_ps(_mm256_max_ps(in, _mm256_sub_ps(_mm256_setzero_ps(), clamp)), clamp);
+        __m256 x2 = _mm256_mul_ps(x, x);
+        __m256 p = _mm256_set1_ps(alpha[6]);
+        for(int k = 5; k >= 0; --k) p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(alpha[k]));
+        __m256 q = _mm256_set1_ps(beta[3]);
+        for(int k = 2; k >= 0; --k) q = _mm256_add_ps(_mm256_mul_ps(q, x2), _mm256_set1_ps(beta[k]));
+        __m256 y = _mm256_div_ps(_mm256_mul_ps(x, p), q);
+        __m256 small = _mm256_cmp_ps(_mm256_and_ps(in, absMask), linear, _CMP_LT_OQ);
+        _mm256_storeu_ps(samples + i, _mm256_blendv_ps(y, in, small));
+    }
+    RationalScalar(samples, i, n);
+}
+
+// tanh over [0, tableEnd], plus the slope to the next point so a lookup
+// is one multiply-add; tanh is odd, so the sign is put back afterwards
+static const int tableSize = 1024;
+static const float tableEnd = 8.f;
+static const float tableScale = tableSize / tableEnd;
+
+struct TanhTable
+{
+    float value[tableSize + 1];
+    float slope[tableSize + 1];
+
+    TanhTable()
+    {
+        for(int i = 0; i <= tableSize; ++i) {
+            value[i] = (float)tanh(i / (double)tableScale);
+        }
+        for(int i = 0; i < tableSize; ++i) {
+            slope[i] = value[i + 1] - value[i];
+        }
+        slope[tableSize] = 0.f;
+    }
+};
+
+static const TanhTable table;
+
+static void TableScalar(float* samples, size_t i, size_t n)
+{
+    for(; i < n; ++i) {
+        float x = samples[i];
+        float f = fminf(fabsf(x) * tableScale, (float)tableSize);
+        int k = (int)f;
+        float y = table.value[k] + (f - k) * table.slope[k];
+        samples[i] = copysignf(y, x);
+    }
+}
+
+SIMD_TARGET_SSE41
+static void TableSse41(float* samples, size_t n)
+{
+    const __m128 scale = _mm_set1_ps(tableScale);
+    const __m128 last = _mm_set1_ps((float)tableSize);
+    const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+    alignas(16) int32_t idx[4];
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(samples + i);
+        __m128 sign = _mm_and_ps(x, signMask);
+        __m128 f = _mm_min_ps(_mm_mul_ps(_mm_andnot_ps(signMask, x), scale), last);
+        __m128 k = _mm_round_ps(f, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        _mm_store_si128((__m128i*)idx, _mm_cvttps_epi32(k));
+        __m128 v = _mm_setr_ps(table.value[idx[0]], table.value[idx[1]], table.value[idx[2]], table.value[idx[3]]);
+        __m128 s = _mm_setr_ps(table.slope[idx[0]], table.slope[idx[1]], table.slope[idx[2]], table.slope[idx[3]]);
+        __m128 y = _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(f, k), s));
+        _mm_storeu_ps(samples + i, _mm_or_ps(y, sign));
+    }
+    TableScalar(samples, i, n);
+}
+
+SIMD_TARGET_AVX2
+static void TableAvx2(float* samples, size_t n)
+{
+    const __m256 scale = _mm256_set1_ps(tableScale);
+    const __m256 last = _mm256_set1_ps((float)tableSize);
+    const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+    size_t i = 0;
+    for(; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(samples + i);
+        __m256 sign = _mm256_and_ps(x, signMask);
+        __m256 f = _mm256_min_ps(_mm256_mul_ps(_mm256_andnot_ps(signMask, x), scale), last);
+        __m256 k = _mm256_round_ps(f, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+        __m256i idx = _mm256_cvttps_epi32(k);
+        __m256 v = _mm256_i32gather_ps(table.value, idx, 4);
+        __m256 s = _mm256_i32gather_ps(table.slope, idx, 4);
+        __m256 y = _mm256_add_ps(v, _mm256_mul_ps(_mm256_sub_ps(f, k), s));
+        _mm256_storeu_ps(samples + i, _mm256_or_ps(y, sign));
+    }
+    TableScalar(samples, i, n);
+}
+
+static const bool hasAvx2 = CpuHasAvx2();
+static const bool hasSse41 = CpuHasSse41();
+
+void SoftClipBlock(SoftClip clip, float* samples, size_t n)
+{
+    switch(clip) {
+    case SoftClip::EXACT:
+        ExactScalar(samples, 0, n);
+        break;
+    case SoftClip::RATIONAL:
+        if(hasAvx2) RationalAvx2(samples, n);
+        else if(hasSse41) RationalSse41(samples, n);
+        else RationalScalar(samples, 0, n);
+        break;
+    case SoftClip::TABLE:
+        if(hasAvx2) TableAvx2(samples, n);
+        else if(hasSse41) TableSse41(samples, n);
+        else TableScalar(samples, 0, n);
+        break;
+    }
+}
+
+#ifdef BENCH_SOFTCLIP
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <functional>
+int main()
+{
+    std::vector<float> mix(1 << 16);
+    for(auto&& f: mix) f = (rand() / (float)RAND_MAX - 0.5f) * 3.f;
+
+    auto bench = [&](char const* name, std::function<void(float*, size_t)> fn) {
+        // every 31st float in [-16, 16], a chunk at a time; past 16 they're
+        // all clamped anyway
+        double maxErr = 0.;
+        std::vector<float> in, out;
+        for(uint32_t sign = 0; sign < 2; ++sign) {
+            for(uint32_t bits = 0; bits <= 0x41800000; ) {
+                in.clear();
+                for(; in.size() < (1 << 16) && bits <= 0x41800000; bits += 31) {
+                    uint32_t b = bits | (sign << 31);
+                    float f;
+                    memcpy(&f, &b, sizeof(f));
+                    in.push_back(f);
+                }
+                out = in;
+                fn(out.data(), out.size());
+                for(size_t i = 0; i < in.size(); ++i) {
+                    maxErr = fmax(maxErr, fabs((double)out[i] - (double)tanhf(in[i])));
+                }
+            }
+        }
+
+        const size_t rounds = 200;
+        std::vector<float> buf(mix.size());
+        auto start = std::chrono::steady_clock::now();
+        for(size_t r = 0; r < rounds; ++r) {
+            memcpy(buf.data(), mix.data(), mix.size() * sizeof(float));
+            fn(buf.data(), buf.size());
+        }
+        auto end = std::chrono::steady_clock::now();
+        printf("%-16s %6.2f ns/sample, max error %.2g\n", name,
+                std::chrono::duration<double, std::nano>(end - start).count() / (rounds * mix.size()),
+                maxErr);
+    };
+
+    bench("exact", [](float* s, size_t n) { ExactScalar(s, 0, n); });
+    bench("rational scalar", [](float* s, size_t n) { RationalScalar(s, 0, n); });
+    if(hasSse41) bench("rational sse4.1", RationalSse41);
+    if(hasAvx2) bench("rational avx2", RationalAvx2);
+    bench("table scalar", [](float* s, size_t n) { TableScalar(s, 0, n); });
+    if(hasSse41) bench("table sse4.1", TableSse41);
+    if(hasAvx2) bench("table avx2", TableAvx2);
+}
+#endif
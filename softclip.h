@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef SOFTCLIP_H
+#define SOFTCLIP_H
+
+#include <cstddef>
+#include <string>
+
+// How the mix is kept within [-1, 1]. All of them approximate tanh; the
+// maximum absolute error against tanhf, measured over [-16, 16], is:
+//
+//   EXACT     0       tanhf itself, one sample at a time
+//   RATIONAL  3.6e-7  [13/6] minimax rational function, clamped at +/-7.9
+//   TABLE     6.0e-6  1024 point table over [0, 8] with linear interpolation
+//
+// Only RATIONAL and TABLE are vectorised, and they are 20 to 40 times
+// faster than EXACT; see bench_softclip in Makefile.gcc. EXACT stays a
+// scalar tanhf loop by design, so that it gives exactly what tanhf does.
+enum class SoftClip
+{
+    EXACT,
+    RATIONAL,
+    TABLE
+};
+
+// parses the name of a soft clipper as given on the command line
+bool ParseSoftClip(std::wstring const& name, SoftClip& clip);
+
+// soft-clips n samples in place
+void SoftClipBlock(SoftClip clip, float* samples, size_t n);
+
+#endif
@@ -30,12 +30,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <cmath>
 #include <map>
 
-typedef struct {
-    stereo_plugin_init_fn init;
-    stereo_plugin_fn fn;
-    stereo_plugin_dispose_fn dispose;
-} plugin_t;
-
 namespace {
     struct pan_state
     {
@@ -54,6 +48,18 @@ namespace {
     };
 }
 
+// FNV-1a
+static uint64_t hash_bytes(uint64_t hash, void const* p, size_t n)
+{
+    auto bytes = (unsigned char const*)p;
+    for(size_t i = 0; i < n; ++i) {
+        hash = (hash ^ bytes[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+static const uint64_t hash_seed = 0xCBF29CE484222325ull;
+
 static void pan_assign_params(pan_state* state, IValue* params)
 {
     switch(params->GetType()) {
@@ -66,7 +72,7 @@ static void pan_assign_params(pan_state* state, IValue* params)
     case IValue::OPTION:
         {
             auto o = (Option*)params;
-            if(o->name.compare(L"pan") == 0) {
+            if(o->name == L"pan") {
                 return pan_assign_params(state, o->value);
             }
         };
@@ -89,12 +95,41 @@ static stereo_state_t pan_init(IValue* params)
     return state;
 }
 
-static stereo_sample_t pan_fn(stereo_state_t pstate, float sample)
+static void pan_block(stereo_state_t pstate, float const* in, float* outL, float* outR, size_t n)
+{
+    auto state = (pan_state*)pstate;
+    float leftGain = 1.f;
+    float rightGain = 1.f;
+    if(state->pan < 0) rightGain = (100 - abs(state->pan))/100.f;
+    else if(state->pan > 0) leftGain = (100 - abs(state->pan))/100.f;
+
+    for(size_t i = 0; i < n; ++i) {
+        outL[i] = leftGain * in[i];
+        outR[i] = rightGain * in[i];
+    }
+}
+
+static stereo_state_t pan_snapshot(stereo_state_t pstate)
+{
+    auto state = (pan_state*)malloc(sizeof(pan_state));
+    memcpy(state, pstate, sizeof(pan_state));
+    return state;
+}
+
+static void pan_restore(stereo_state_t pstate, stereo_state_t snapshot)
+{
+    memcpy(pstate, snapshot, sizeof(pan_state));
+}
+
+static size_t pan_snapshot_size(stereo_state_t)
+{
+    return sizeof(pan_state);
+}
+
+static uint64_t pan_hash(stereo_state_t pstate)
 {
     auto state = (pan_state*)pstate;
-    if(state->pan < 0) return {sample, ((100 - abs(state->pan))/100.f) * sample};
-    else if(state->pan > 0) return {((100 - abs(state->pan))/100.f) * sample, sample};
-    return {sample, sample};
+    return hash_bytes(hash_seed, &state->pan, sizeof(state->pan));
 }
 
 static void pan_dispose(stereo_state_t pstate)
@@ -117,28 +152,28 @@ static void chorus_assign_params(chorus_state* state, IValue* params)
     case IValue::OPTION:
         {
             auto o = (Option*)params;
-            if(o->name.compare(L"delay") == 0) {
+            if(o->name == L"delay") {
                 if(o->value->GetType() == IValue::SCALAR) {
                     auto value = wcstol(((Scalar*)o->value)->value.c_str(), nullptr, 10);
                     state->delay = (int)(value/100.f * 2048.f);
                 }
-            } else if(o->name.compare(L"pan") == 0) {
+            } else if(o->name == L"pan") {
                 if(o->value->GetType() == IValue::SCALAR) {
                     auto value = wcstol(((Scalar*)o->value)->value.c_str(), nullptr, 10);
                     state->pan = value;
                 }
-            } else if(o->name.compare(L"amount") == 0) {
+            } else if(o->name == L"amount") {
                 if(o->value->GetType() == IValue::SCALAR) {
                     auto value = wcstol(((Scalar*)o->value)->value.c_str(), nullptr, 10);
                     state->amount = value/100.f;
                 }
-            } else if(o->name.compare(L"speed") == 0) {
+            } else if(o->name == L"speed") {
                 if(o->value->GetType() == IValue::SCALAR) {
                     auto value = wcstol(((Scalar*)o->value)->value.c_str(), nullptr, 10);
 
                     state->steps = 44100 / (value / 100.f * 20.f);
                 }
-            } else if(o->name.compare(L"depth") == 0) {
+            } else if(o->name == L"depth") {
                 if(o->value->GetType() == IValue::SCALAR) {
                     auto value = wcstol(((Scalar*)o->value)->value.c_str(), nullptr, 10);
 
@@ -146,6 +181,10 @@ static void chorus_assign_params(chorus_state* state, IValue* params)
                 }
             }
         };
+        break;
+    case IValue::SCALAR:
+        // unlike pan, there's no one obvious parameter a bare value sets
+        break;
     }
 }
 
@@ -164,18 +203,10 @@ static stereo_state_t chorus_init(IValue* params)
     return state;
 }
 
-static stereo_sample_t chorus_fn(stereo_state_t pstate, float sample)
+static void chorus_block(stereo_state_t pstate, float const* in, float* outL, float* outR, size_t n)
 {
     auto state = (chorus_state*)pstate;
 
-    auto lfoA = sin(2 * 3.14159 * (state->phase/44100.0));
-    auto delay = state->delay + state->depth*lfoA;
-    state->writeHead = (state->writeHead + 1) % 4096;
-    state->buffer[state->writeHead] = sample;
-    auto s0 = sample;
-    auto s1 = state->buffer[(state->writeHead + 4096 - state->delay) % 4096];
-    auto s2 = state->buffer[(state->writeHead + 4096 - 2*state->delay) % 4096];
-
     float leftGain = 1.f;
     float rightGain = 1.f;
     float gain0 = 1.f - state->amount/2.f;
@@ -193,31 +224,89 @@ static stereo_sample_t chorus_fn(stereo_state_t pstate, float sample)
         gain2 = state->amount * 0.33;
     }
 
-    float amount = state->amount / 100.f;
-    float left = leftGain * gain0 * s0 + leftGain * gain1 * s1;
-    float right = rightGain * gain0 * s0 + rightGain * gain2 * s2;
+    size_t writeHead = state->writeHead;
+    size_t delay1 = 4096 - state->delay;
+    size_t delay2 = 4096 - 2*state->delay;
+    for(size_t i = 0; i < n; ++i) {
+        writeHead = (writeHead + 1) % 4096;
+        state->buffer[writeHead] = in[i];
+        auto s0 = in[i];
+        auto s1 = state->buffer[(writeHead + delay1) % 4096];
+        auto s2 = state->buffer[(writeHead + delay2) % 4096];
 
-    state->phase = (state->phase + state->steps) % 44100;
+        outL[i] = leftGain * gain0 * s0 + leftGain * gain1 * s1;
+        outR[i] = rightGain * gain0 * s0 + rightGain * gain2 * s2;
+    }
+    state->writeHead = writeHead;
 
-    return {left, right};
+    state->phase = (int)((state->phase + (long long)state->steps * n) % 44100);
+}
+
+static void chorus_skip(stereo_state_t pstate, float const* in, size_t n)
+{
+    auto state = (chorus_state*)pstate;
+
+    // only the last 4096 samples can still be heard through the delay line
+    size_t first = (n > 4096) ? n - 4096 : 0;
+    size_t writeHead = (state->writeHead + first) % 4096;
+    for(size_t i = first; i < n; ++i) {
+        writeHead = (writeHead + 1) % 4096;
+        state->buffer[writeHead] = in[i];
+    }
+    state->writeHead = writeHead;
+
+    state->phase = (int)((state->phase + (long long)state->steps * n) % 44100);
+}
+
+static stereo_state_t chorus_snapshot(stereo_state_t pstate)
+{
+    return new chorus_state(*(chorus_state*)pstate);
+}
+
+static void chorus_restore(stereo_state_t pstate, stereo_state_t snapshot)
+{
+    *(chorus_state*)pstate = *(chorus_state*)snapshot;
+}
+
+static size_t chorus_snapshot_size(stereo_state_t)
+{
+    return sizeof(chorus_state);
+}
+
+static uint64_t chorus_hash(stereo_state_t pstate)
+{
+    auto state = (chorus_state*)pstate;
+    uint64_t hash = hash_seed;
+    hash = hash_bytes(hash, &state->delay, sizeof(state->delay));
+    hash = hash_bytes(hash, &state->pan, sizeof(state->pan));
+    hash = hash_bytes(hash, &state->amount, sizeof(state->amount));
+    // the output only depends on the delay line relative to the write
+    // head; the LFO phase doesn't currently affect it at all
+    size_t first = (state->writeHead + 1) % 4096;
+    hash = hash_bytes(hash, state->buffer + first, (4096 - first) * sizeof(float));
+    hash = hash_bytes(hash, state->buffer, first * sizeof(float));
+    return hash;
 }
 
 static void chorus_dispose(stereo_state_t pstate)
 {
-    free(pstate);
+    delete (chorus_state*)pstate;
 }
 
 // TODO dynamic loading
 static std::map<std::wstring, plugin_t> instanceMap{
-    { L"pan", { pan_init, pan_fn, pan_dispose }},
-    { L"chorus", { chorus_init, chorus_fn, chorus_dispose }}
+    { L"pan", { pan_init, pan_block, nullptr, pan_snapshot, pan_restore, pan_snapshot_size, pan_hash, pan_dispose }},
+    { L"chorus", { chorus_init, chorus_block, chorus_skip, chorus_snapshot, chorus_restore, chorus_snapshot_size, chorus_hash, chorus_dispose }}
 };
 
 StereoInstance* NewStereoInstance(std::wstring name, IValue* params)
 {
     auto&& found = instanceMap.find(name);
-    if(found == instanceMap.end()) return new StereoInstance(new pan_state{0}, pan_fn, pan_dispose);
+    if(found == instanceMap.end()) {
+        auto&& pan = instanceMap.at(L"pan");
+        return new StereoInstance(pan.init(nullptr), pan);
+    }
     auto&& plugin = found->second;
     auto state = plugin.init(params);
-    return new StereoInstance(state, plugin.fn, plugin.dispose);
+    return new StereoInstance(state, plugin);
 }
@@ -28,6 +28,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define STEREO_H
 
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
 struct IValue;
 
@@ -38,31 +40,68 @@ typedef struct {
 typedef void* stereo_state_t;
 
 typedef stereo_state_t (*stereo_plugin_init_fn)(IValue* params);
-typedef stereo_sample_t (*stereo_plugin_fn)(stereo_state_t state, float mono_sample);
+// processes n mono samples from in into outL and outR
+typedef void (*stereo_plugin_block_fn)(stereo_state_t state, float const* in, float* outL, float* outR, size_t n);
+// advances the state exactly as block would, without producing any output;
+// null for plugins whose state never changes, which can then be skipped
+// without working out their input
+typedef void (*stereo_plugin_skip_fn)(stereo_state_t state, float const* in, size_t n);
+// returns a new, independent copy of the state
+typedef stereo_state_t (*stereo_plugin_snapshot_fn)(stereo_state_t state);
+// overwrites state with a copy of snapshot
+typedef void (*stereo_plugin_restore_fn)(stereo_state_t state, stereo_state_t snapshot);
+// how many bytes a snapshot of state takes
+typedef size_t (*stereo_plugin_snapshot_size_fn)(stereo_state_t state);
+// hashes everything in the state that can affect future output; states
+// with the same hash produce the same output from the same input
+typedef uint64_t (*stereo_plugin_hash_fn)(stereo_state_t state);
 typedef void (*stereo_plugin_dispose_fn)(stereo_state_t);
 
+typedef struct {
+    stereo_plugin_init_fn init;
+    stereo_plugin_block_fn block;
+    stereo_plugin_skip_fn skip;
+    stereo_plugin_snapshot_fn snapshot;
+    stereo_plugin_restore_fn restore;
+    stereo_plugin_snapshot_size_fn snapshot_size;
+    stereo_plugin_hash_fn hash;
+    stereo_plugin_dispose_fn dispose;
+} plugin_t;
+
 struct StereoInstance;
 
 StereoInstance* NewStereoInstance(std::wstring name, IValue* params);
 
 struct StereoInstance {
-    stereo_sample_t operator()(float sample) { return fn(state, sample); }
-    ~StereoInstance() { dispose(state); }
+    void operator()(float const* in, float* outL, float* outR, size_t n) { plugin.block(state, in, outL, outR, n); }
+    stereo_sample_t operator()(float sample)
+    {
+        stereo_sample_t rval;
+        plugin.block(state, &sample, &rval.data[0], &rval.data[1], 1);
+        return rval;
+    }
+    void Skip(float const* in, size_t n) { if(plugin.skip) plugin.skip(state, in, n); }
+    // if Skip ignores its input
+    bool Stateless() const { return !plugin.skip; }
+    StereoInstance* Snapshot() const { return new StereoInstance(plugin.snapshot(state), plugin); }
+    void Restore(StereoInstance const& snapshot) { plugin.restore(state, snapshot.state); }
+    size_t SnapshotSize() const { return plugin.snapshot_size(state); }
+    uint64_t Hash() const { return plugin.hash(state); }
+    ~StereoInstance() { plugin.dispose(state); }
 
 private:
     stereo_state_t state;
-    stereo_plugin_fn fn;
-    stereo_plugin_dispose_fn dispose;
+    plugin_t plugin;
 
 private:
-    StereoInstance(stereo_state_t state_,
-            stereo_plugin_fn fn_,
-            stereo_plugin_dispose_fn dispose_)
-        : dispose(dispose_)
-          , fn(fn_)
-          , state(state_)
+    StereoInstance(stereo_state_t state_, plugin_t const& plugin_)
+        : state(state_)
+          , plugin(plugin_)
     {}
 
+    StereoInstance(StereoInstance const&) = delete;
+    StereoInstance& operator=(StereoInstance const&) = delete;
+
     friend StereoInstance* NewStereoInstance(std::wstring, IValue*);
 };
 
@@ -24,72 +24,151 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include <cstring>
-#include <cstdlib>
 #include <cstdio>
-#include <cctype>
+#include <cwctype>
 #include <string>
-#include <sstream>
 #include <vector>
-#include <functional>
 #include <errorassert.h>
+#include <simd.h>
+#ifdef _MSC_VER
+# include <io.h>
+# include <fcntl.h>
+#endif
 
 #include <tokenizer.h>
 #include <parser.h>
 #include <parser_types.h>
 
-int tokenizer_lineno = 1;
+// input is read this much at a time
+static const size_t readSize = 1 << 16;
 
-Tokenizer::Tokenizer(FILE* f_)
-    : f(f_)
+Tokenizer::Tokenizer(FILE* f)
+    : pos(0)
+    , line(1)
+    , column(1)
 {
-    if(feof(f)) c = WEOF;
-    else c = fgetwc(f);
+#ifdef _MSC_VER
+    _setmode(_fileno(f), _O_BINARY);
+#endif
+    std::vector<char> bytes;
+    size_t got = 0;
+    do {
+        bytes.resize(got + readSize);
+        got += fread(&bytes[got], 1, readSize, f);
+    } while(got == bytes.size());
+    ASSERT(!ferror(f), L"Failed to read input");
+    Decode(bytes.data(), got);
 }
 
-Token Tokenizer::operator()()
+Tokenizer::Tokenizer(char const* utf8, size_t size)
+    : pos(0)
+    , line(1)
+    , column(1)
+{
+    Decode(utf8, size);
+}
+
+// Malformed sequences become U+FFFD. On Windows, wchar_t is UTF-16, so
+// anything past the BMP becomes a surrogate pair.
+void Tokenizer::Decode(char const* utf8, size_t size)
 {
-    if(c == WEOF) return {TEOF};
-    while(iswspace(c) || c == L'\u000D' || c == L'\u000A')
-    {
-        if(c == L'\u000A') tokenizer_lineno++;
-        c = fgetwc(f);
-        if(feof(f)) return {TEOF};
+    unsigned char const* in = (unsigned char const*)utf8;
+    // never more characters than bytes
+    text.resize(size);
+    wchar_t* out = &text[0];
+    size_t i = 0;
+
+    // skip the BOM
+    if(size >= 3 && in[0] == 0xEF && in[1] == 0xBB && in[2] == 0xBF) i = 3;
+
+    while(i < size) {
+        // runs of ASCII are just widened, sixteen bytes at a time
+        size_t j = i;
+        while(j + 16 <= size && _mm_movemask_epi8(_mm_loadu_si128((__m128i const*)(in + j))) == 0) j += 16;
+        while(j < size && in[j] < 0x80) ++j;
+        for(; i < j; ++i) *out++ = (wchar_t)in[i];
+        if(i == size) break;
+
+        unsigned c = in[i];
+        size_t length = (c >= 0xF0 && c < 0xF5) ? 4 : (c >= 0xE0 && c < 0xF0) ? 3 : (c >= 0xC2 && c < 0xE0) ? 2 : 0;
+        unsigned code = (length == 4) ? (c & 0x07) : (length == 3) ? (c & 0x0F) : (c & 0x1F);
+        size_t k = 1;
+        for(; length && k < length && i + k < size && (in[i + k] & 0xC0) == 0x80; ++k) {
+            code = (code << 6) | (in[i + k] & 0x3F);
+        }
+        bool valid = length && k == length
+            && !(length == 3 && code < 0x800)
+            && !(length == 4 && (code < 0x10000 || code > 0x10FFFF))
+            && !(code >= 0xD800 && code < 0xE000);
+        i += k;
+        if(!valid) {
+            *out++ = L'\uFFFD';
+        } else if(sizeof(wchar_t) == 2 && code >= 0x10000) {
+            code -= 0x10000;
+            *out++ = (wchar_t)(0xD800 + (code >> 10));
+            *out++ = (wchar_t)(0xDC00 + (code & 0x3FF));
+        } else {
+            *out++ = (wchar_t)code;
+        }
     }
-    if(c == L'[') { c = fgetwc(f); return {LSQUARE}; }
-    if(c == L']') { c = fgetwc(f); return {RSQUARE}; }
-    if(c == L'(') { c = fgetwc(f); return {LPAREN}; }
-    if(c == L')') { c = fgetwc(f); return {RPAREN}; }
-    if(c == L'=') { c = fgetwc(f); return {EQUALS}; }
-
-    std::wstringstream ss;
-    std::function<bool(wchar_t)> conditions[] = {
-        [](wchar_t c) -> bool {
-            return !(isspace(c)
-                    || c == L'\u000A'
-                    || c == L'\u000D'
-                    || c == L'['
-                    || c == L']'
-                    || c == L'('
-                    || c == L')'
-                    || c == L'='
-                    );
-        },
-        [](wchar_t c) -> bool {
-            return c != L'"';
-        },
-    };
-    bool quoted = (c == L'"');
-    auto condition = conditions[quoted];
-    if(quoted) c = fgetwc(f);
-    while(condition(c))
-    {
-        if(c == L'\u000A') tokenizer_lineno++;
-        ss << (wchar_t)c;
-        c = fgetwc(f);
-        if(feof(f)) break;
+
+    text.resize(out - text.data());
+}
+
+static bool IsSpace(wchar_t c)
+{
+    if(c < 0x80) return c == L' ' || (c >= L'\t' && c <= L'\r');
+    return iswspace(c) != 0;
+}
+
+static bool IsPunctuation(wchar_t c)
+{
+    return c == L'[' || c == L']' || c == L'(' || c == L')' || c == L'=';
+}
+
+void Tokenizer::Advance()
+{
+    if(text[pos++] == L'\n') {
+        ++line;
+        column = 1;
+    } else {
+        ++column;
     }
-    if(quoted) c = fgetwc(f);
-    //return {STRING, ss.str()}; // curly bracket form crashes msvc 18.00.21005.1
-    return Token(STRING, ss.str());
 }
 
+Token Tokenizer::operator()()
+{
+    while(pos < text.size() && IsSpace(text[pos])) Advance();
+
+    Token token = { TEOF, { text.data() + pos, 0, line, column } };
+    if(pos == text.size()) return token;
+
+    switch(text[pos]) {
+    case L'[': token.type = LSQUARE; break;
+    case L']': token.type = RSQUARE; break;
+    case L'(': token.type = LPAREN; break;
+    case L')': token.type = RPAREN; break;
+    case L'=': token.type = EQUALS; break;
+    default: token.type = STRING; break;
+    }
+    if(token.type != STRING) {
+        token.text.size = 1;
+        Advance();
+        return token;
+    }
+
+    if(text[pos] == L'"') {
+        // everything up to the closing quote, or the end of the input
+        Advance();
+        size_t start = pos;
+        while(pos < text.size() && text[pos] != L'"') Advance();
+        token.text.data = text.data() + start;
+        token.text.size = pos - start;
+        if(pos < text.size()) Advance();
+    } else {
+        size_t start = pos;
+        while(pos < text.size() && !IsSpace(text[pos]) && !IsPunctuation(text[pos])) Advance();
+        token.text.size = pos - start;
+    }
+    return token;
+}
@@ -23,28 +23,55 @@ CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
 OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
 #include <cstdio>
+#include <cstddef>
 #include <string>
-#include <string_utils.h>
 
 #define TEOF (0)
 
+// A token's text, pointing into the tokenizer's buffer (so it's only
+// good for as long as the tokenizer is around, and isn't terminated),
+// and where it starts in the input, counting from 1.
+struct TokenText
+{
+    wchar_t const* data;
+    size_t size;
+    int line;
+    int column;
+
+    std::wstring str() const { return std::wstring(data, size); }
+};
+
 struct Token
 {
     typedef int Type;
     Type type;
-    std::wstring value;
-    Token(Type type_, std::wstring value_ = L"")
-        : type(type_), value(value_)
-    {}
+    TokenText text;
 };
 
+// Splits a .drm file into tokens. The whole input is decoded from UTF-8
+// up front, so tokens can point straight into it.
 struct Tokenizer
 {
-    FILE* f;
-    wint_t c;
-
-    Tokenizer(FILE* f_);
+    // reads all of f
+    explicit Tokenizer(FILE* f);
+    Tokenizer(char const* utf8, size_t size);
 
     Token operator()();
+
+private:
+    std::wstring text;
+    size_t pos;
+    int line, column;
+
+    void Decode(char const* utf8, size_t size);
+    void Advance();
+
+    Tokenizer(Tokenizer const&) = delete;
+    Tokenizer& operator=(Tokenizer const&) = delete;
 };
+
+#endif
@@ -9,21 +9,41 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include <cstring>
 #include <cstdint>
 #include <cstdio>
+#include <cerrno>
 #include <vector>
 #include <string>
 #include <stdexcept>
 #include <exception>
 #include <string_utils.h>
+#include <wave.h>
+#include <pcm.h>
+#ifdef _MSC_VER
+# include <io.h>
+# include <fcntl.h>
+#else
+# include <fcntl.h>
+#endif
+
+// converted samples are collected and written this many bytes at a time;
+// a song comes in a few hundred frames at a time otherwise
+static const size_t writeBufferSize = 1 << 20;
+// header sizes for a stream of unknown length, as most readers expect
+static const uint64_t unknownLength = (uint64_t)-1;
+// the largest size a RIFF header can hold; 0xFFFFFFFF means unknown
+static const uint64_t riffSizeLimit = 0xFFFFFFFE;
 
 #ifdef __GNUC__
 # pragma GCC diagnostic push
 # pragma GCC diagnostic ignored "-Wmultichar"
 # pragma GCC diagnostic ignored "-Wnarrowing"
 #endif
-static void wav_write_header(FILE* f, unsigned samplPerSec, unsigned numSamples, unsigned numChannels)
+// numSamples is per channel, or unknownLength. Files too big for 32bit
+// sizes become RF64 (EBU Tech 3306): every header has room for the ds64
+// chunk, which is a JUNK chunk until it's needed, so a file can be
+// turned into one after it's been written.
+static void wav_write_header(FILE* f, unsigned samplPerSec, uint64_t numSamples, unsigned numChannels, PcmFormat format)
 {
-    // for PCM: M = 2
-#define M 4
+    const unsigned M = (unsigned)PcmSampleSize(format);
 #define NC numChannels
 #define NS numSamples
 #define F samplPerSec
@@ -34,6 +54,15 @@ static void wav_write_header(FILE* f, unsigned samplPerSec, unsigned numSamples,
         uint32_t ckId;
         uint32_t cksize;
         uint32_t WAVEID;
+        uint32_t ds64_ckId;
+        uint32_t ds64_cksize;
+        uint32_t ds64_riffSizeLow;
+        uint32_t ds64_riffSizeHigh;
+        uint32_t ds64_dataSizeLow;
+        uint32_t ds64_dataSizeHigh;
+        uint32_t ds64_sampleCountLow;
+        uint32_t ds64_sampleCountHigh;
+        uint32_t ds64_tableLength;
         uint32_t fmt_ckId;
         uint32_t fmt_cksize;
         uint16_t wFormatTag;
@@ -47,13 +76,21 @@ static void wav_write_header(FILE* f, unsigned samplPerSec, unsigned numSamples,
         uint32_t data_factDwSampleLength;
         uint32_t data_ckId;
         uint32_t data_cksize;
-    } header = {
+    };
+    uint64_t dataSize = (uint64_t)M /*B per sample*/ * NC /*N channels*/ * NS;
+    uint64_t riffSize = sizeof(wav_header_s) - 8 + dataSize;
+    uint64_t sampleCount = (uint64_t)NC * NS;
+
+    wav_header_s header = {
         'FFIR', // little endian RIFF
-        4 + 26 + 12 + (8 + M /*B per sample*/ * NC /*N channels*/ * NS + 0),
+        (uint32_t)riffSize,
         'EVAW', // little endian WAVE
+        'KNUJ', // little endian JUNK; room for ds64
+        28,
+        0, 0, 0, 0, 0, 0, 0,
         ' tmf', // little endian fmt 
         16,
-        WAVE_FORMAT_IEEE_FLOAT, // 1 = PCM, 3 = float
+        (format == PcmFormat::F32 || format == PcmFormat::F64) ? WAVE_FORMAT_IEEE_FLOAT : WAVE_FORMAT_PCM,
         NC,
         F,
         F * M * NC,
@@ -61,16 +98,33 @@ static void wav_write_header(FILE* f, unsigned samplPerSec, unsigned numSamples,
         8 * M,
         'tcaf', // little endian fact
         4,
-        NC * NS,
+        (uint32_t)sampleCount,
         'atad', // little endian data
-        M * NC * NS,
+        (uint32_t)dataSize,
     };
+    if(numSamples == unknownLength) {
+        header.cksize = 0xFFFFFFFF;
+        header.data_factDwSampleLength = 0xFFFFFFFF;
+        header.data_cksize = 0xFFFFFFFF;
+    } else if(riffSize > riffSizeLimit) {
+        // the 32bit sizes say "look in ds64"
+        header.ckId = '46FR'; // little endian RF64
+        header.cksize = 0xFFFFFFFF;
+        header.ds64_ckId = '46sd'; // little endian ds64
+        header.ds64_riffSizeLow = (uint32_t)riffSize;
+        header.ds64_riffSizeHigh = (uint32_t)(riffSize >> 32);
+        header.ds64_dataSizeLow = (uint32_t)dataSize;
+        header.ds64_dataSizeHigh = (uint32_t)(dataSize >> 32);
+        header.ds64_sampleCountLow = (uint32_t)sampleCount;
+        header.ds64_sampleCountHigh = (uint32_t)(sampleCount >> 32);
+        header.data_factDwSampleLength = 0xFFFFFFFF;
+        header.data_cksize = 0xFFFFFFFF;
+    }
 
     size_t hr = fwrite(&header, sizeof(wav_header_s), 1, f);
     if(hr != 1 || ferror(f)) {
         throw std::runtime_error(std::string(strerror(errno)));
     }
-#undef M
 #undef NC
 #undef NS
 #undef F
@@ -79,31 +133,121 @@ static void wav_write_header(FILE* f, unsigned samplPerSec, unsigned numSamples,
 # pragma GCC diagnostic pop
 #endif
 
-static void wav_write_samples(FILE* f, std::vector<float> const& samples)
+static void wav_write_bytes(FILE* f, void const* bytes, size_t numBytes)
 {
-    size_t hr = fwrite(samples.data(), sizeof(float), samples.size(), f);
-    if(hr != samples.size() || ferror(f)) {
+    size_t hr = fwrite(bytes, 1, numBytes, f);
+    if(hr != numBytes || ferror(f)) {
         throw std::runtime_error(std::string(strerror(errno)));
     }
 }
 
-void wav_write_file(std::wstring const& filename, std::vector<float> const& samples, unsigned samples_per_second, unsigned numChannels)
+// Every write to a stream opened for appending lands at its end, so its
+// header can't be patched in place even if it can seek. The CRT on
+// Windows has no way of asking.
+static bool is_appending(FILE* f)
+{
+#ifdef _MSC_VER
+    return false;
+#else
+    int flags = fcntl(fileno(f), F_GETFL);
+    return flags != -1 && (flags & O_APPEND) != 0;
+#endif
+}
+
+WavWriter::WavWriter(std::wstring const& filename_, unsigned samplesPerSecond_, unsigned numChannels_, PcmFormat format_, bool dither_)
+    : filename(filename_)
+    , f(nullptr)
+    , seekable(false)
+    , headerOffset(0)
+    , samplesPerSecond(samplesPerSecond_)
+    , numChannels(numChannels_)
+    , numFrames(0)
+    , format(format_)
+    , dithering(dither_)
+    , buffer(writeBufferSize)
+    , buffered(0)
 {
-    FILE* f = open_write_binary(filename.c_str());
+    if(filename == L"-") {
+#ifdef _MSC_VER
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        f = stdout;
+    } else {
+        f = open_write_binary(filename.c_str());
+    }
     if(!f) {
         throw std::invalid_argument(W2MB(std::wstring() + L"Failed to open " + filename + L" for writing").get());
     }
 
     try {
         clearerr(f);
-        wav_write_header(f, samples_per_second, samples.size() / numChannels, numChannels);
-        wav_write_samples(f, samples);
+        // stdout may already have something in it
+        headerOffset = ftell(f);
+        seekable = (headerOffset != -1) && !is_appending(f);
+        wav_write_header(f, samplesPerSecond, seekable ? 0 : unknownLength, numChannels, format);
+    } catch(std::exception e) {
+        Release();
+        throw std::runtime_error(std::string() + "Failed to write wave file: " + e.what());
+    }
+}
+
+WavWriter::~WavWriter()
+{
+    if(f) Release();
+}
+
+void WavWriter::Release()
+{
+    if(f != stdout) close_file(f);
+    f = nullptr;
+}
+
+void WavWriter::Write(float const* samples, size_t numFrames_)
+{
+    try {
+        size_t numSamples = numFrames_ * numChannels;
+        size_t numBytes = numSamples * PcmSampleSize(format);
+        if(buffered + numBytes > buffer.size()) {
+            wav_write_bytes(f, buffer.data(), buffered);
+            buffered = 0;
+            if(numBytes > buffer.size()) buffer.resize(numBytes);
+        }
+        FloatToPcm(format, samples, &buffer[buffered], numSamples, dithering ? &dither : nullptr);
+        buffered += numBytes;
+        numFrames += numFrames_;
+    } catch(std::exception e) {
+        throw std::runtime_error(std::string() + "Failed to write wave file: " + e.what());
+    }
+}
+
+void WavWriter::Close()
+{
+    try {
+        wav_write_bytes(f, buffer.data(), buffered);
+        buffered = 0;
+        if(seekable) {
+            if(fseek(f, headerOffset, SEEK_SET) != 0) {
+                throw std::runtime_error(std::string(strerror(errno)));
+            }
+            wav_write_header(f, samplesPerSecond, numFrames, numChannels, format);
+        }
+        // buffered writes only fail here
+        if(fflush(f) != 0 || ferror(f)) {
+            throw std::runtime_error(std::string(strerror(errno)));
+        }
     } catch(std::exception e) {
-        close_file(f);
+        Release();
         throw std::runtime_error(std::string() + "Failed to write wave file: " + e.what());
     }
 
-    close_file(f);
+    Release();
+}
+
+void wav_write_file(std::wstring const& filename, std::vector<float> const& samples, unsigned samples_per_second, unsigned numChannels)
+{
+    WavWriter w(filename, samples_per_second, numChannels);
+    w.Write(samples.data(), samples.size() / numChannels);
+    w.Close();
 }
 
 #ifdef TEST_WAVE
@@ -116,6 +260,6 @@ int main()
         thing.push_back(sin(3.14159f * 2.0 * 440.0 / 44100.0 * i));
     }
 
-    (void) wav_write_file(L"test.wav", thing, 44100);
+    (void) wav_write_file(L"test.wav", thing, 44100, 1);
 }
 #endif
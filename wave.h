@@ -0,0 +1,56 @@
+/*
+Copyright (c) 2014-2017 Vlad Mesco
+All rights reserved.
+Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+#ifndef WAVE_H
+#define WAVE_H
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <sink.h>
+#include <pcm.h>
+
+// Writes a wave file a few frames at a time, converting (and optionally
+// dithering) the samples to format on the way out. The header is written
+// up front and patched with the final size by Close(), which turns the
+// file into RF64 if it's grown past 4GB. A filename of "-" means stdout;
+// if that's a pipe, the header can't be patched and says the length is
+// unknown.
+struct WavWriter : Sink
+{
+    WavWriter(std::wstring const& filename, unsigned samplesPerSecond, unsigned numChannels, PcmFormat format = PcmFormat::F32, bool dither = false);
+    ~WavWriter();
+
+    // samples holds numFrames * numChannels interleaved samples
+    void Write(float const* samples, size_t numFrames) override;
+    void Close() override;
+
+private:
+    std::wstring filename;
+    FILE* f;
+    bool seekable;
+    long headerOffset; // where the header went, which may not be 0 on stdout
+    unsigned samplesPerSecond;
+    unsigned numChannels;
+    uint64_t numFrames; // can outgrow 32bit sizes
+    PcmFormat format;
+    bool dithering;
+    PcmDither dither;
+    std::vector<unsigned char> buffer;
+    size_t buffered; // bytes
+
+    void Release();
+
+    WavWriter(WavWriter const&) = delete;
+    WavWriter& operator=(WavWriter const&) = delete;
+};
+
+void wav_write_file(std::wstring const& filename, std::vector<float> const& samples, unsigned samples_per_second, unsigned numChannels);
+
+#endif
@@ -0,0 +1,109 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <wavreader.h>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+
+#define WAVE_FORMAT_PCM 0x0001
+#define WAVE_FORMAT_IEEE_FLOAT 0x0003
+#define WAVE_FORMAT_EXTENSIBLE 0xFFFE
+
+static uint16_t ReadU16(uint8_t const* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t ReadU32(uint8_t const* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ReadU64(uint8_t const* p)
+{
+    return (uint64_t)ReadU32(p) | ((uint64_t)ReadU32(p + 4) << 32);
+}
+
+WavInfo ParseWav(uint8_t const* data, size_t size)
+{
+    bool rf64 = (size >= 12 && memcmp(data, "RF64", 4) == 0);
+    if(size < 12 || (!rf64 && memcmp(data, "RIFF", 4) != 0) || memcmp(data + 8, "WAVE", 4) != 0) {
+        throw std::runtime_error("not a RIFF/WAVE or RF64 file");
+    }
+
+    WavInfo info;
+    bool haveFormat = false;
+    uint64_t dataSize64 = 0; // from ds64, for RF64 files
+    size_t pos = 12;
+    while(pos + 8 <= size) {
+        uint8_t const* chunk = data + pos;
+        size_t chunkSize = ReadU32(chunk + 4);
+        size_t available = size - pos - 8;
+
+        if(memcmp(chunk, "fmt ", 4) == 0) {
+            if(chunkSize < 16 || chunkSize > available) throw std::runtime_error("truncated fmt chunk");
+            unsigned tag = ReadU16(chunk + 8);
+            info.numChannels = ReadU16(chunk + 10);
+            info.samplesPerSecond = ReadU32(chunk + 12);
+            info.frameSize = ReadU16(chunk + 20);
+            info.bitsPerSample = ReadU16(chunk + 22);
+            if(tag == WAVE_FORMAT_EXTENSIBLE) {
+                // the real format tag leads the subformat GUID
+                if(chunkSize < 40) throw std::runtime_error("truncated WAVE_FORMAT_EXTENSIBLE header");
+                tag = ReadU16(chunk + 8 + 24);
+            }
+            switch(tag) {
+            case WAVE_FORMAT_PCM: info.encoding = WavInfo::Encoding::PCM; break;
+            case WAVE_FORMAT_IEEE_FLOAT: info.encoding = WavInfo::Encoding::FLOAT; break;
+            default: throw std::runtime_error("unsupported format tag " + std::to_string(tag));
+            }
+            if(info.numChannels == 0 || info.samplesPerSecond == 0
+                    || info.bitsPerSample == 0 || info.bitsPerSample % 8 != 0
+                    || info.frameSize != info.numChannels * info.bitsPerSample / 8)
+            {
+                throw std::runtime_error("inconsistent fmt chunk");
+            }
+            haveFormat = true;
+        } else if(memcmp(chunk, "ds64", 4) == 0) {
+            if(chunkSize < 24 || chunkSize > available) throw std::runtime_error("truncated ds64 chunk");
+            dataSize64 = ReadU64(chunk + 16);
+        } else if(memcmp(chunk, "data", 4) == 0) {
+            if(!haveFormat) throw std::runtime_error("data chunk before fmt chunk");
+            uint64_t dataSize = (rf64 && chunkSize == 0xFFFFFFFF) ? dataSize64 : chunkSize;
+            info.dataOffset = pos + 8;
+            info.numFrames = (size_t)std::min<uint64_t>(dataSize, available) / info.frameSize;
+            return info;
+        }
+
+        // chunks are padded to an even size
+        if(chunkSize > available) break;
+        pos += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    throw std::runtime_error(haveFormat ? "no data chunk" : "no fmt chunk");
+}
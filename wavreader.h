@@ -0,0 +1,59 @@
+/*
+Copyright (c) 2017, Vlad Meșco
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+
+* Redistributions of source code must retain the above copyright notice, this
+  list of conditions and the following disclaimer.
+
+* Redistributions in binary form must reproduce the above copyright notice,
+  this list of conditions and the following disclaimer in the documentation
+  and/or other materials provided with the distribution.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef WAVREADER_H
+#define WAVREADER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Where the samples are in a RIFF/WAVE file held in memory, and what
+// they look like.
+struct WavInfo
+{
+    enum class Encoding {
+        PCM, // signed integers, or unsigned for 8 bits
+        FLOAT
+    };
+
+    Encoding encoding;
+    unsigned bitsPerSample; // of the container; any padding bits are ignored
+    unsigned numChannels;
+    unsigned samplesPerSecond;
+    size_t dataOffset; // of the first frame, from the start of the file
+    size_t numFrames;
+    size_t frameSize; // in bytes
+};
+
+// Finds the fmt and data chunks of a wave file, understanding plain and
+// WAVE_FORMAT_EXTENSIBLE headers as well as RF64 files, whose sizes come
+// from the ds64 chunk, and skipping any other chunk. A data chunk running
+// past the end of the file (as left by a writer which never went back to
+// patch it) is cut short. Throws std::runtime_error if the file isn't a
+// wave file or has no samples in a known format.
+WavInfo ParseWav(uint8_t const* data, size_t size);
+
+#endif